@@ -48,6 +48,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors a single READ or WRITE SECTOR command can move.
+   A sector count of 0 in the command means 256. */
+#define MAX_SECTORS 256
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -84,7 +88,9 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void transfer (struct disk *, disk_sector_t,
+		const struct disk_iovec *, size_t iov_cnt, bool write);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -206,21 +212,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -230,23 +222,114 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * DISK_SECTOR_SIZE bytes.
+   The sectors are transferred with as few commands as the
+   controller allows, instead of one command per sector. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
+	struct disk_iovec iov = { buffer, cnt };
+	disk_readv (d, sec_no, &iov, 1);
+}
+
+/* Writes the CNT sectors starting at SEC_NO on disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes, as
+   disk_read_multiple() does for reading.  Returns after the disk
+   has acknowledged receiving the data. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
+	struct disk_iovec iov = { (void *) buffer, cnt };
+	disk_writev (d, sec_no, &iov, 1);
+}
+
+/* Reads consecutive sectors starting at SEC_NO from disk D into
+   the IOV_CNT buffers in IOV, filling each in turn, as a single
+   run of sectors. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iovec *iov, size_t iov_cnt) {
+	transfer (d, sec_no, iov, iov_cnt, false);
+}
+
+/* Writes the IOV_CNT buffers in IOV, one after another, to disk D
+   as a single run of sectors starting at SEC_NO. */
+void
+disk_writev (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iovec *iov, size_t iov_cnt) {
+	transfer (d, sec_no, iov, iov_cnt, true);
+}
+
+/* Transfers the sectors described by the IOV_CNT buffers in IOV
+   between them and disk D, starting at sector SEC_NO, writing to
+   the disk if WRITE is true and reading from it otherwise.
+
+   Each READ or WRITE SECTOR command moves up to MAX_SECTORS
+   sectors.  The controller still interrupts once per sector, but
+   the channel is locked, the device selected and the command
+   issued only once per command. */
+static void
+transfer (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iovec *iov, size_t iov_cnt, bool write) {
 	struct channel *c;
+	size_t total = 0, i;
+	size_t iov_idx = 0, iov_ofs = 0;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (iov != NULL || iov_cnt == 0);
+
+	for (i = 0; i < iov_cnt; i++) {
+		ASSERT (iov[i].buffer != NULL);
+		total += iov[i].sector_cnt;
+	}
+	ASSERT (sec_no + total <= d->capacity);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	while (total > 0) {
+		size_t cnt = total < MAX_SECTORS ? total : MAX_SECTORS;
+
+		select_sector (d, sec_no, cnt);
+		issue_pio_command (c, write ? CMD_WRITE_SECTOR_RETRY
+				: CMD_READ_SECTOR_RETRY);
+		for (i = 0; i < cnt; i++) {
+			uint8_t *sector;
+
+			while (iov_ofs == iov[iov_idx].sector_cnt) {
+				iov_idx++;
+				iov_ofs = 0;
+			}
+			sector = (uint8_t *) iov[iov_idx].buffer
+				+ iov_ofs++ * DISK_SECTOR_SIZE;
+
+			/* A read interrupts when each sector is ready.  A write
+			   asks for each sector with DRQ and interrupts once the
+			   disk has taken it. */
+			if (!write)
+				sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+						write ? "write" : "read", (disk_sector_t) (sec_no + i));
+			if (write) {
+				output_sector (c, sector);
+				sema_down (&c->completion_wait);
+			} else
+				input_sector (c, sector);
+		}
+		if (write)
+			d->write_cnt += cnt;
+		else
+			d->read_cnt += cnt;
+		sec_no += cnt;
+		total -= cnt;
+	}
 	lock_release (&c->lock);
 }
-
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -399,17 +482,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
+   writes SEC_NO and the number of sectors CNT, at most
+   MAX_SECTORS, to the disk's sector selection registers.  (We
    use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= MAX_SECTORS);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt % MAX_SECTORS);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
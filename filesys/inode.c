@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
 #ifdef EFILESYS
 #include "filesys/fat.h"
 #endif
@@ -43,9 +45,11 @@ bytes_to_sectors (off_t size) {
 /* In-memory inode. */
 struct inode {
 	struct list_elem elem;              /* Element in inode list. */
+	struct list_elem unused_elem;       /* Element in unused list. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
+	bool loading;                       /* True while DATA is being read. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
 };
@@ -93,13 +97,40 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 #endif
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.
+ * An inode whose last opener closes it stays on this list, and
+ * is also put on unused_inodes (most recently closed first), so
+ * that opening it again needs no disk read.  At most
+ * MAX_UNUSED_INODES are kept, fewer when memory runs low. */
 static struct list open_inodes;
+static struct list unused_inodes;
+static size_t unused_cnt;
+static struct lock inodes_lock;     /* Protects the lists above. */
+static struct condition inode_loaded; /* Signaled when an inode is read. */
+
+#define MAX_UNUSED_INODES 64
+
+static void inode_unlink (struct inode *);
+static void inode_free (struct inode *);
+static size_t inode_count_unused (void);
+static size_t inode_scan_unused (size_t nr_to_scan);
+
+/* Frees unused inodes when the kernel pool runs low. */
+static struct shrinker inode_shrinker = {
+	.name = "inodes",
+	.priority = SHRINK_PRI_OBJECTS,
+	.count = inode_count_unused,
+	.scan = inode_scan_unused,
+};
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	list_init (&unused_inodes);
+	lock_init (&inodes_lock);
+	cond_init (&inode_loaded);
+	shrinker_register (&inode_shrinker);
 }
 
 #ifdef EFILESYS
@@ -179,36 +210,60 @@ inode_open (disk_sector_t sector) {
 	struct list_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
+	lock_acquire (&inodes_lock);
+
+	/* Check whether this inode is already open, or was recently. */
 	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
 			e = list_next (e)) {
 		inode = list_entry (e, struct inode, elem);
 		if (inode->sector == sector) {
-			inode_reopen (inode);
+			if (inode->open_cnt++ == 0) {
+				list_remove (&inode->unused_elem);
+				unused_cnt--;
+				inode->deny_write_cnt = 0;
+			}
+			while (inode->loading)
+				cond_wait (&inode_loaded, &inodes_lock);
+			lock_release (&inodes_lock);
 			return inode; 
 		}
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
+	/* Initialize.  The inode goes on the list before it is read,
+	 * so that the disk read happens without holding inodes_lock;
+	 * anyone else opening it meanwhile waits for the read. */
 	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	inode->loading = true;
+	lock_release (&inodes_lock);
+
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	lock_acquire (&inodes_lock);
+	inode->loading = false;
+	cond_broadcast (&inode_loaded, &inodes_lock);
+	lock_release (&inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&inodes_lock);
 		inode->open_cnt++;
+		lock_release (&inodes_lock);
+	}
 	return inode;
 }
 
@@ -218,52 +273,109 @@ inode_get_inumber (const struct inode *inode) {
 	return inode->sector;
 }
 
-#ifdef EFILESYS
+/* Closes INODE and writes it to disk.
+ * If this was the last reference to INODE, frees its memory, or
+ * keeps it around unused for a later inode_open().
+ * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	struct inode *victim = NULL;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
+	lock_acquire (&inodes_lock);
+
 	/* Release resources if this was the last opener. */
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			fat_remove_chain (sector_to_cluster (inode->sector), 0);
-			fat_remove_chain (inode->data.start, 0); 
+		if (inode->removed)
+			victim = inode;
+		else {
+			list_push_front (&unused_inodes, &inode->unused_elem);
+			if (++unused_cnt > MAX_UNUSED_INODES) {
+				victim = list_entry (list_pop_back (&unused_inodes),
+						struct inode, unused_elem);
+				unused_cnt--;
+			}
 		}
-		free (inode); 
+		if (victim != NULL)
+			inode_unlink (victim);
 	}
+
+	lock_release (&inodes_lock);
+
+	/* Freeing blocks may touch the disk, so do it unlocked. */
+	if (victim != NULL)
+		inode_free (victim);
 }
+
+/* Removes INODE, which nobody has open and which is not on the
+ * unused list, from the inode list, so that no inode_open() can
+ * find it any more.  The caller then frees it with inode_free()
+ * after dropping inodes_lock. */
+static void
+inode_unlink (struct inode *inode) {
+	ASSERT (lock_held_by_current_thread (&inodes_lock));
+	ASSERT (inode->open_cnt == 0);
+
+	list_remove (&inode->elem);
+}
+
+/* Frees INODE, already unlinked by inode_unlink(), along with its
+ * blocks if it was removed. */
+static void
+inode_free (struct inode *inode) {
+	ASSERT (!lock_held_by_current_thread (&inodes_lock));
+
+	/* Deallocate blocks if removed. */
+	if (inode->removed) {
+#ifdef EFILESYS
+		fat_remove_chain (sector_to_cluster (inode->sector), 0);
+		fat_remove_chain (inode->data.start, 0); 
 #else
-/* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
- * If INODE was also a removed inode, frees its blocks. */
-void
-inode_close (struct inode *inode) {
-	/* Ignore null pointer. */
-	if (inode == NULL)
-		return;
+		free_map_release (inode->sector, 1);
+		free_map_release (inode->data.start,
+				bytes_to_sectors (inode->data.length)); 
+#endif
+	}
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
-		}
+	free (inode); 
+}
+
+/* Returns the number of unused inodes.  Unlocked, so only an
+ * estimate. */
+static size_t
+inode_count_unused (void) {
+	return unused_cnt;
+}
+
+/* Frees up to NR_TO_SCAN unused inodes, least recently closed
+ * first, and returns the number freed. */
+static size_t
+inode_scan_unused (size_t nr_to_scan) {
+	struct list victims;
+	size_t freed = 0;
 
-		free (inode); 
+	if (lock_held_by_current_thread (&inodes_lock)
+			|| !lock_try_acquire (&inodes_lock))
+		return 0;
+	list_init (&victims);
+	while (unused_cnt > 0 && freed < nr_to_scan) {
+		struct inode *inode = list_entry (list_pop_back (&unused_inodes),
+				struct inode, unused_elem);
+		unused_cnt--;
+		inode_unlink (inode);
+		list_push_back (&victims, &inode->unused_elem);
+		freed++;
 	}
+	lock_release (&inodes_lock);
+
+	while (!list_empty (&victims))
+		inode_free (list_entry (list_pop_front (&victims),
+					struct inode, unused_elem));
+	return freed;
 }
-#endif
 
 /* Marks INODE to be deleted when it is closed by the last caller who
  * has it open. */
@@ -298,8 +410,17 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+			/* Read full sectors directly into caller's buffer, as
+			 * many in one transfer as follow each other on disk. */
+			size_t cnt = 1;
+			while (size >= (off_t) (cnt + 1) * DISK_SECTOR_SIZE
+					&& inode_left >= (off_t) (cnt + 1) * DISK_SECTOR_SIZE
+					&& byte_to_sector (inode, offset + cnt * DISK_SECTOR_SIZE)
+					== sector_idx + cnt)
+				cnt++;
+			disk_read_multiple (filesys_disk, sector_idx, buffer + bytes_read,
+					cnt);
+			chunk_size = cnt * DISK_SECTOR_SIZE;
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
@@ -2,6 +2,7 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,6 +16,13 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* One buffer of a scattered transfer: SECTOR_CNT sectors of
+ * DISK_SECTOR_SIZE bytes each, starting at BUFFER. */
+struct disk_iovec {
+	void *buffer;
+	size_t sector_cnt;
+};
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,5 +30,12 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+		size_t cnt);
+void disk_readv (struct disk *, disk_sector_t, const struct disk_iovec *,
+		size_t iov_cnt);
+void disk_writev (struct disk *, disk_sector_t, const struct disk_iovec *,
+		size_t iov_cnt);
 
 #endif /* devices/disk.h */
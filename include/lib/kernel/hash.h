@@ -6,28 +6,43 @@
  * This data structure is thoroughly documented in the Tour of
  * Pintos for Project 3.
  *
- * This is a standard hash table with chaining.  To locate an
- * element in the table, we compute a hash function over the
- * element's data and use that as an index into an array of
- * doubly linked lists, then linearly search the list.
+ * This is an open-addressing hash table with Robin Hood
+ * insertion.  The table is an array of slots, each holding a
+ * pointer to an element and the element's hash value.  An element
+ * lives at or after its "home" slot, given by its hash value, and
+ * insertion keeps every element as close to home as the others
+ * allow: whenever the element being placed is further from its
+ * home than a slot's occupant, the two swap places and placement
+ * continues with the displaced one.  That keeps probe sequences
+ * short even at high load, and lets a search stop as soon as it
+ * meets an element closer to home than the key would be.  Since
+ * slots carry hash values, a search only touches the elements
+ * whose hash values match.
  *
- * The chain lists do not use dynamic allocation.  Instead, each
- * structure that can potentially be in a hash must embed a
- * struct hash_elem member.  All of the hash functions operate on
- * these `struct hash_elem's.  The hash_entry macro allows
- * conversion from a struct hash_elem back to a structure object
- * that contains it.  This is the same technique used in the
- * linked list implementation.  Refer to lib/kernel/list.h for a
- * detailed explanation. */
+ * The table grows and shrinks incrementally.  A resize allocates
+ * the new slot array and leaves the old one in place; each later
+ * insertion or deletion then moves a few slots' worth of elements
+ * across, and searches look in both arrays until the old one is
+ * empty.  No single operation pays for rehashing a large table.
+ *
+ * No dynamic allocation happens per element.  Each structure that
+ * can potentially be in a hash must embed a struct hash_elem
+ * member, and all of the hash functions operate on these `struct
+ * hash_elem's.  The hash_entry macro allows conversion from a
+ * struct hash_elem back to a structure object that contains it.
+ * This is the same technique used in the linked list
+ * implementation.  Refer to lib/kernel/list.h for a detailed
+ * explanation. */
 
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "list.h"
 
-/* Hash element. */
+/* Hash element.  Tables refer to elements by address, so there is
+ * nothing to store in one; it only marks where an element is
+ * embedded, for hash_entry(). */
 struct hash_elem {
-	struct list_elem list_elem;
 };
 
 /* Converts pointer to hash element HASH_ELEM into a pointer to
@@ -36,8 +51,8 @@ struct hash_elem {
  * of the hash element.  See the big comment at the top of the
  * file for an example. */
 #define hash_entry(HASH_ELEM, STRUCT, MEMBER)                   \
-	((STRUCT *) ((uint8_t *) &(HASH_ELEM)->list_elem        \
-		- offsetof (STRUCT, MEMBER.list_elem)))
+	((STRUCT *) ((uint8_t *) (HASH_ELEM)                    \
+		- offsetof (STRUCT, MEMBER)))
 
 /* Computes and returns the hash value for hash element E, given
  * auxiliary data AUX. */
@@ -50,15 +65,31 @@ typedef bool hash_less_func (const struct hash_elem *a,
 		const struct hash_elem *b,
 		void *aux);
 
+/* Returns true if hash element E matches KEY, given auxiliary
+ * data AUX.  Used by hash_lookup(). */
+typedef bool hash_equal_func (const struct hash_elem *e, const void *key,
+		void *aux);
+
 /* Performs some operation on hash element E, given auxiliary
  * data AUX. */
 typedef void hash_action_func (struct hash_elem *e, void *aux);
 
+/* A slot in a hash table's slot array. */
+struct hash_slot {
+	uint64_t hash;              /* Hash value of ELEM. */
+	struct hash_elem *elem;     /* Element, or null if empty. */
+};
+
 /* Hash table. */
 struct hash {
 	size_t elem_cnt;            /* Number of elements in table. */
-	size_t bucket_cnt;          /* Number of buckets, a power of 2. */
-	struct list *buckets;       /* Array of `bucket_cnt' lists. */
+	size_t slot_cnt;            /* Number of slots, a power of 2. */
+	size_t max_elems;           /* Grow when holding more elements. */
+	struct hash_slot *slots;    /* Array of `slot_cnt' slots. */
+	struct hash_slot *old_slots; /* Slots being moved out, or null. */
+	size_t old_slot_cnt;        /* Number of old slots. */
+	size_t old_elem_cnt;        /* Elements left in old slots. */
+	size_t old_idx;             /* Next old slot to move out. */
 	hash_hash_func *hash;       /* Hash function. */
 	hash_less_func *less;       /* Comparison function. */
 	void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -67,10 +98,60 @@ struct hash {
 /* A hash table iterator. */
 struct hash_iterator {
 	struct hash *hash;          /* The hash table. */
-	struct list *bucket;        /* Current bucket. */
-	struct hash_elem *elem;     /* Current hash element in current bucket. */
+	size_t idx;                 /* Current slot, counting old ones last. */
+	struct hash_elem *elem;     /* Current hash element. */
 };
 
+/* Marks an old slot whose element has been moved out or deleted.
+ * Searches continue past it. */
+#define HASH_MOVED ((struct hash_elem *) 1)
+
+/* Returns the index of the slot among the SLOT_CNT at SLOTS that
+ * holds an element with hash value HASH for which EQUAL returns
+ * true, or SIZE_MAX if there is none.  Used by hash_lookup() and
+ * hash.c; not part of the interface. */
+static inline size_t
+hash_probe_ (const struct hash_slot *slots, size_t slot_cnt, uint64_t hash,
+		hash_equal_func *equal, const void *key, void *aux) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = hash & mask;
+	size_t dist;
+
+	for (dist = 0; dist < slot_cnt; dist++, idx = (idx + 1) & mask) {
+		const struct hash_slot *s = &slots[idx];
+
+		if (s->elem == NULL)
+			break;
+		if (s->elem == HASH_MOVED)
+			continue;
+		if (((idx - s->hash) & mask) < dist)
+			break;
+		if (s->hash == hash && equal (s->elem, key, aux))
+			return idx;
+	}
+	return SIZE_MAX;
+}
+
+/* Finds and returns an element of H with hash value HASH for
+ * which EQUAL (E, KEY, AUX) returns true, or a null pointer if
+ * there is none.  Unlike hash_find(), this needs no element to
+ * compare against, and being inline lets the compiler inline
+ * EQUAL too. */
+static inline struct hash_elem *
+hash_lookup (const struct hash *h, uint64_t hash,
+		hash_equal_func *equal, const void *key, void *aux) {
+	size_t idx = hash_probe_ (h->slots, h->slot_cnt, hash, equal, key, aux);
+
+	if (idx != SIZE_MAX)
+		return h->slots[idx].elem;
+	if (h->old_slots != NULL) {
+		idx = hash_probe_ (h->old_slots, h->old_slot_cnt, hash, equal, key, aux);
+		if (idx != SIZE_MAX)
+			return h->old_slots[idx].elem;
+	}
+	return NULL;
+}
+
 /* Basic life cycle. */
 bool hash_init (struct hash *, hash_hash_func *, hash_less_func *, void *aux);
 void hash_clear (struct hash *, hash_action_func *);
@@ -97,4 +178,17 @@ uint64_t hash_bytes (const void *, size_t);
 uint64_t hash_string (const char *);
 uint64_t hash_int (int);
 
+/* Returns a hash of X, which may be a pointer or an integer.
+ * This is the finalizer of the SplitMix64 generator: every bit of
+ * X affects every bit of the result. */
+static inline uint64_t
+hash_u64 (uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
 #endif /* lib/kernel/hash.h */
@@ -0,0 +1,87 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Pairing heap.
+ *
+ * A priority queue with O(1) insertion and amortized O(log n)
+ * removal of the least element, for schedulers and timers that
+ * only ever need the minimum and would otherwise keep a sorted
+ * list.  Like lists, heaps do not use dynamically allocated
+ * memory: each structure that is a potential heap element must
+ * embed a struct heap_elem member, and the heap_entry macro
+ * converts a struct heap_elem back to the structure that contains
+ * it.  Refer to lib/kernel/list.h for a detailed explanation of
+ * the technique.
+ *
+ * For example, a queue of sleeping threads by wake-up time:
+ *
+ * static bool
+ * wakeup_less (const struct heap_elem *a, const struct heap_elem *b,
+ *              void *aux UNUSED) {
+ *   return heap_entry (a, struct thread, sleep_elem)->wakeup
+ *          < heap_entry (b, struct thread, sleep_elem)->wakeup;
+ * }
+ *
+ * heap_init (&sleepers, wakeup_less, NULL);
+ * heap_push (&sleepers, &t->sleep_elem);
+ * ...
+ * while (!heap_empty (&sleepers)
+ *        && heap_entry (heap_top (&sleepers), struct thread,
+ *                       sleep_elem)->wakeup <= now)
+ *   thread_unblock (heap_entry (heap_pop (&sleepers),
+ *                               struct thread, sleep_elem));
+ *
+ * The top of the heap is a least element according to LESS.
+ * Unlike list_insert_ordered(), the heap is not stable: elements
+ * that compare equal come out in no particular order.  Give the
+ * comparison a tie-breaker, such as a sequence number, if that
+ * matters. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* First child, or null. */
+	struct heap_elem *next;     /* Next sibling, or null. */
+	struct heap_elem *prev;     /* Previous sibling or parent; null
+	                               for the root. */
+};
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Pairing heap. */
+struct heap {
+	struct heap_elem *root;     /* Least element, or null if empty. */
+	size_t size;                /* Number of elements. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element.  See the big comment at the top of the
+   file for an example. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+		- offsetof (STRUCT, MEMBER.child)))
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_top (struct heap *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+size_t heap_size (struct heap *);
+bool heap_empty (struct heap *);
+
+#endif /* lib/kernel/heap.h */
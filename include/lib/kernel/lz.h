@@ -0,0 +1,38 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ77-family compression.
+ *
+ * A small byte-oriented codec in the style of LZ4, meant for
+ * squeezing pages in memory rather than for archiving: it makes a
+ * single greedy pass with a hash table of recent positions, and
+ * decompression is a plain copy loop.  Typical pages of program
+ * data compress to a half or less; random data does not compress
+ * at all, and the compressor says so instead of expanding it.
+ *
+ * The compressed format is a sequence of tokens.  Each token
+ * byte holds a literal count in its high nibble and a match
+ * length minus LZ_MIN_MATCH in its low nibble; a nibble of 15 is
+ * extended by following bytes, each adding up to 255, until one
+ * below 255.  The literals follow, then a two-byte little-endian
+ * offset back to the start of the match.  The last token has
+ * literals only and no offset.
+ *
+ * The compressor needs LZ_WORK_SIZE bytes of scratch memory,
+ * which the caller provides so that it can be used where stack
+ * space is tight. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ_MIN_MATCH 4                  /* Shortest match encoded. */
+#define LZ_MAX_INPUT 65535              /* Longest input accepted. */
+#define LZ_HASH_BITS 10                 /* log2 of hash table size. */
+#define LZ_WORK_SIZE (sizeof (uint16_t) << LZ_HASH_BITS)
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,121 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * An ordered container with O(log n) insertion, removal and
+ * search, for the places where a list kept in order with
+ * list_insert_ordered() gets too slow.  Like lists, trees do not
+ * use dynamically allocated memory: each structure that is a
+ * potential tree element must embed a struct rb_elem member, and
+ * the rb_entry macro converts a struct rb_elem back to the
+ * structure that contains it.  Refer to lib/kernel/list.h for a
+ * detailed explanation of the technique.
+ *
+ * For example, a tree of `struct foo' ordered by `bar':
+ *
+ * struct foo {
+ *   struct rb_elem elem;
+ *   int bar;
+ *   ...other members...
+ * };
+ *
+ * static bool
+ * foo_less (const struct rb_elem *a, const struct rb_elem *b,
+ *           void *aux UNUSED) {
+ *   return rb_entry (a, struct foo, elem)->bar
+ *          < rb_entry (b, struct foo, elem)->bar;
+ * }
+ *
+ * struct rbtree foo_tree;
+ *
+ * rb_init (&foo_tree, foo_less, NULL);
+ *
+ * and in-order iteration:
+ *
+ * struct rb_elem *e;
+ *
+ * for (e = rb_begin (&foo_tree); e != rb_end (&foo_tree);
+ * e = rb_next (e)) {
+ *   struct foo *f = rb_entry (e, struct foo, elem);
+ *   ...do something with f...
+ * }
+ *
+ * Elements that compare equal may be inserted any number of times.
+ * They keep their insertion order, as with list_insert_ordered(),
+ * so a tree also works as a FIFO-within-priority queue.
+ *
+ * The end of a traversal is a null pointer, returned by rb_end()
+ * and rb_rend().  As with lists, there is no type checking; an
+ * element must be in at most one tree at a time through any one
+ * rb_elem. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or null for the root. */
+	struct rb_elem *left;       /* Left child: less or equal. */
+	struct rb_elem *right;      /* Right child: greater or equal. */
+	bool red;                   /* Red or black? */
+};
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rbtree {
+	struct rb_elem *root;       /* Root, or null if empty. */
+	size_t size;                /* Number of elements. */
+	rb_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element.  See the big comment at the top of the file for
+   an example. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+	((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+void rb_init (struct rbtree *, rb_less_func *, void *aux);
+
+/* Tree traversal, in order. */
+struct rb_elem *rb_begin (struct rbtree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_end (struct rbtree *);
+
+struct rb_elem *rb_rbegin (struct rbtree *);
+struct rb_elem *rb_prev (struct rb_elem *);
+struct rb_elem *rb_rend (struct rbtree *);
+
+/* Tree insertion. */
+void rb_insert (struct rbtree *, struct rb_elem *);
+
+/* Tree removal. */
+struct rb_elem *rb_remove (struct rbtree *, struct rb_elem *);
+struct rb_elem *rb_pop_front (struct rbtree *);
+struct rb_elem *rb_pop_back (struct rbtree *);
+
+/* Tree elements. */
+struct rb_elem *rb_front (struct rbtree *);
+struct rb_elem *rb_back (struct rbtree *);
+
+/* Search. */
+struct rb_elem *rb_find (struct rbtree *, const struct rb_elem *key);
+struct rb_elem *rb_lower_bound (struct rbtree *, const struct rb_elem *key);
+struct rb_elem *rb_upper_bound (struct rbtree *, const struct rb_elem *key);
+
+/* Tree properties. */
+size_t rb_size (struct rbtree *);
+bool rb_empty (struct rbtree *);
+
+#endif /* lib/kernel/rbtree.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Memory management constants shared by the kernel and user
+ * programs. */
+
+/* Advice for madvise(). */
+#define MADV_NORMAL     0       /* No particular pattern. */
+#define MADV_RANDOM     1       /* Random access: do not read ahead. */
+#define MADV_SEQUENTIAL 2       /* Sequential access: read ahead more,
+                                   and evict behind the reader. */
+#define MADV_WILLNEED   3       /* Will be used soon: read it in now. */
+#define MADV_DONTNEED   4       /* Not needed: drop the contents now. */
+
+/* Flags for mmap(), ORed into its WRITABLE argument. */
+#define MAP_ANONYMOUS   0x20    /* Zero-filled memory, not backed by a
+                                   file: FD must be -1, OFFSET 0. */
+#define MAP_POPULATE    0x8000  /* Load all the pages now, not on
+                                   first use. */
+
+#endif /* lib/mman.h */
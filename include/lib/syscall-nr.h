@@ -36,6 +36,12 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3.  Appended, so that the numbers above
+	   do not change. */
+	SYS_MADVISE,                /* Advise on the use of memory. */
+	SYS_MLOCK,                  /* Lock pages in memory. */
+	SYS_MUNLOCK,                /* Unlock pages. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <mman.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -39,8 +40,11 @@ void close (int fd);
 int dup2(int oldfd, int newfd);
 
 /* Project 3 and optionally project 4. */
-void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);  /* WRITABLE may include MAP_* flags. */
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -0,0 +1,41 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+#include <stddef.h>
+
+/* Allocation tracking, for finding out where kernel memory goes.
+
+   Built in with `make MEMTRACK=1' (after a `make clean').  Every
+   live malloc() block and palloc_get_*() allocation is then
+   recorded with the address it was requested from, and
+   memtrack_report() prints the live bytes and counts per call
+   site.  The report is printed at shutdown and can be requested
+   at any other time, e.g. with `call memtrack_report ()' in gdb.
+   Allocations that a process made and that are still live after
+   it exits are counted as orphaned.
+
+   Without MEMTRACK the hooks below compile to nothing. */
+
+struct thread;
+
+/* Kinds of tracked allocation. */
+enum memtrack_kind {
+	MT_MALLOC,                  /* malloc(), calloc(), realloc(). */
+	MT_PALLOC                   /* palloc_get_*(). */
+};
+
+#ifdef MEMTRACK
+void memtrack_init (void);
+void memtrack_alloc (void *, size_t size, void *caller, enum memtrack_kind);
+void memtrack_free (void *);
+void memtrack_exit (struct thread *);
+void memtrack_report (void);
+#else
+#define memtrack_init() ((void) 0)
+#define memtrack_alloc(PTR, SIZE, CALLER, KIND) ((void) 0)
+#define memtrack_free(PTR) ((void) 0)
+#define memtrack_exit(T) ((void) 0)
+#define memtrack_report() ((void) 0)
+#endif
+
+#endif /* threads/memtrack.h */
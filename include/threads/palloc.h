@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -11,13 +12,47 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* A cache that can give memory back to the kernel pool.
+
+   When the kernel pool runs low, the page allocator calls each
+   registered shrinker's COUNT, and for those that have anything
+   to give calls SCAN with the number of pages it still needs.
+   SCAN should free up to that many of its objects and return how
+   many it freed; the allocator measures the pages that came back
+   itself.  Both are called with no pool locks held, but possibly
+   from inside any palloc_get_*() or malloc() call, so a shrinker
+   must only try-acquire its own locks and skip anything it cannot
+   get. */
+struct shrinker {
+	const char *name;               /* Shown in statistics. */
+	int priority;                   /* Lower priorities are asked first. */
+	size_t (*count) (void);         /* Number of objects it could free. */
+	size_t (*scan) (size_t nr_to_scan); /* Free objects, return count. */
+
+	/* Owned by the page allocator. */
+	struct list_elem elem;          /* Element in shrinker list. */
+	long long calls;                /* Number of SCAN calls. */
+	long long freed;                /* Objects freed by SCAN. */
+	long long pages;                /* Pages that came back during SCAN. */
+};
+
+/* Shrinker priorities.  Objects that live in malloc() memory are
+   reclaimed before malloc()'s own arena cache, so that arenas they
+   empty can be returned in the same pass. */
+#define SHRINK_PRI_OBJECTS 0
+#define SHRINK_PRI_ARENAS 10
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_huge_page (enum palloc_flags);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void shrinker_register (struct shrinker *);
+size_t palloc_free_cnt (enum palloc_flags);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -41,5 +41,17 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=2 MiB page (PDEs only). */
+
+/* Huge pages.
+   A page directory entry with PTE_PS set maps a 2 MiB, 2 MiB-aligned
+   physical range directly instead of pointing to a page table. */
+#define HPGSHIFT PDXSHIFT                        /* Index of first offset bit. */
+#define HPGSIZE  (1UL << HPGSHIFT)               /* Bytes in a huge page. */
+#define HPGMASK  (HPGSIZE - 1)                   /* Huge page offset bits. */
+#define HPG_PAGES (HPGSIZE / PGSIZE)             /* 4 kB pages per huge page. */
+
+/* Round down to nearest huge page boundary. */
+#define hpg_round_down(va) ((void *) ((uint64_t) (va) & ~HPGMASK))
 
 #endif /* threads/pte.h */
@@ -133,6 +133,9 @@ struct thread {
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
 	uintptr_t syscall_rsp;
+	uint64_t exec_tsc;                  /* TSC at exec, until the first system call. */
+	size_t exec_faults;                 /* Page faults taken since exec. */
+	size_t mlocked_cnt;                 /* Pages locked in memory by mlock(). */
 #endif
 #ifdef EFILESYS
 	struct dir* current_dir;		/* Current Directory. */
@@ -0,0 +1,26 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+
+/* Kernel virtual address range reserved for vmalloc().
+ * It sits in the same page-map-level-4 slot as the physical memory
+ * map at KERN_BASE, so every pml4 copied from base_pml4 sees the
+ * mappings without further work. */
+#define VMALLOC_START 0xc000000000UL
+#define VMALLOC_SIZE  (256UL * 1024 * 1024)
+#define VMALLOC_END   (VMALLOC_START + VMALLOC_SIZE)
+
+/* Returns true if VADDR lies in the vmalloc range. */
+#define is_vmalloc_vaddr(vaddr) \
+	((uint64_t) (vaddr) >= VMALLOC_START && (uint64_t) (vaddr) < VMALLOC_END)
+
+void vmalloc_init (void);
+void *vmalloc (enum palloc_flags, size_t page_cnt);
+void vfree (void *);
+void vmalloc_print_stats (void);
+
+#endif /* threads/vmalloc.h */
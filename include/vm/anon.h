@@ -11,21 +11,52 @@ enum vm_type;
 
 #define SECTORS_PER_PAGE  (PGSIZE / DISK_SECTOR_SIZE)
 
-struct swap_slot{  //This is an entry in the swap table.
-  struct list_elem elem;
-  bool free;
-  uint32_t slotNo;  //Slot number : This corresponds to the swap disk's sector #(slotNo * 8). 
-};
+/* Swap slot index of an anonymous page that is not on the swap disk. */
+#define NO_SLOT SIZE_MAX
+
+/* Most pages anon_swap_out_batch() writes at once. */
+#define SWAP_BATCH 8
+
+/* Most pages read ahead on one swap-in. */
+#define SWAP_READAHEAD 7
+
+/* Marks the pages of anonymous mappings made by mmap(), so that munmap() can
+ * tell them from other anonymous pages. */
+#define VM_ANON_MAP VM_MARKER_1
+
+/* -zswap=COUNT: keep swapped out pages compressed in up to COUNT
+ * pages' worth of kernel memory before they go to the swap disk. */
+extern size_t vm_zswap_pages;
+
+struct zswap_entry;
+struct ksm_node;
+struct text_frame;
 
 struct anon_page {
   vm_initializer* init;
   struct lazy_aux* aux;
   enum vm_type type;
-  struct swap_slot* slot;
+  size_t slot;  //Swap slot holding the contents, sectors slot * 8 ~ slot * 8 + 7, or NO_SLOT.
+  void* cache;  //Copy of the slot read ahead into the swap cache, or NULL.
+  struct list_elem cache_elem;  //Element in the swap cache, if CACHE.
+  struct zswap_entry* zswap;  //Compressed copy in the zswap pool, or NULL.
+  bool zero;  //Swapped out while all zeros : nothing was stored.
+  struct ksm_node* ksm;  //Frame shared read-only with identical pages, or NULL.
+  struct text_frame* text;  //Executable text frame shared with other processes, or NULL.
+  struct list_elem text_elem;  //Element in its sharers, if TEXT.
+  uint64_t* text_pml4;  //Page table mapping it, if TEXT.
 };
 
 
 void vm_anon_init (void);
+void *do_mmap_anon (void *addr, size_t length, bool writable);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t anon_swap_out_batch (struct page *pages[], size_t cnt);
+bool anon_swap_out_shared (struct page *page);
+void anon_share_slot (struct page *page, struct page *from);
+bool anon_fork_swapped (struct page *dst, struct page *src);
+void *anon_swap_cache_take (struct page *page);
+bool anon_swap_cache_shrink (void);
+void vm_anon_print_stats (void);
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+
+#include <stdbool.h>
+
+/* Same-page merging.
+ *
+ * With -ksm, a background thread walks the frame table looking
+ * for anonymous frames with identical contents, possibly in
+ * different processes, and makes their pages share a single
+ * read-only frame.  The first write to a merged page faults and
+ * gives it a private copy again, like copy-on-write after fork.
+ *
+ * A frame is only considered once its contents have not changed
+ * between two visits of the scanner, so that pages being written
+ * are not merged just to be unmerged again.  Candidates are
+ * hashed and checked byte for byte before merging. */
+
+struct frame;
+struct page;
+struct ksm_node;
+
+/* -ksm=PERCENT: largest share of the CPU the scanner may use, or
+   0 if it does not run. */
+extern unsigned vm_ksm_budget;
+
+void ksm_init (void);
+void ksm_frame_unlinked (struct frame *);
+bool ksm_copy (struct page *dst, struct page *src);
+bool ksm_unmerge (struct page *);
+void ksm_drop (struct page *);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
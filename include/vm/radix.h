@@ -0,0 +1,44 @@
+#ifndef VM_RADIX_H
+#define VM_RADIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Radix tree keyed by user virtual page.
+ *
+ * The tree has the same shape as an x86-64 page table: four levels
+ * of 512-entry nodes, one page each, indexed by the same 9-bit
+ * fields of the virtual address.  A lookup is four dependent loads
+ * with no hashing or comparisons, pages that are close in the
+ * address space sit next to each other in the same leaf, and
+ * walking a range of addresses visits the leaves in order.
+ *
+ * Nodes are only freed by radix_destroy(), like the page tables
+ * that pml4_clear_page() leaves behind. */
+
+#define RADIX_BITS 9                        /* Index bits per level. */
+#define RADIX_FANOUT (1 << RADIX_BITS)      /* Slots per node. */
+#define RADIX_LEVELS 4                      /* Levels, root to leaf. */
+
+struct radix_node;
+
+/* Radix tree. */
+struct radix_tree {
+	struct radix_node *root;    /* Top-level node, or null if empty. */
+	size_t cnt;                 /* Number of values. */
+	struct radix_node *hint;    /* Leaf used by the last lookup. */
+	uint64_t hint_base;         /* First address covered by HINT. */
+};
+
+/* Performs some operation on value V, for radix_destroy(). */
+typedef void radix_action_func (void *v);
+
+void radix_init (struct radix_tree *);
+void *radix_lookup (struct radix_tree *, const void *va);
+bool radix_insert (struct radix_tree *, const void *va, void *v);
+void *radix_remove (struct radix_tree *, const void *va);
+void *radix_next (struct radix_tree *, void **va);
+void radix_destroy (struct radix_tree *, radix_action_func *);
+
+#endif /* vm/radix.h */
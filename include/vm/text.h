@@ -0,0 +1,35 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+
+#include <stdbool.h>
+
+/* Shared executable text.
+ *
+ * With -share-text, the read-only pages of executable segments
+ * are not loaded into frames of their own.  A cache of frames
+ * keyed by inode, file offset and length holds one copy of each
+ * such page, and every process running the same program maps
+ * that copy, counted by reference.  Forked children share it
+ * too.  The frame goes back to the user pool when the last page
+ * mapping it is destroyed.
+ *
+ * Text frames are not in the frame table.  When user memory runs
+ * out they are reclaimed before any frame is evicted, by a clock
+ * over the cache that passes over frames any sharer has accessed
+ * since the last look.  A reclaimed frame is unmapped from all its
+ * sharers, whose pages become uninitialized again, so their next
+ * fault finds or loads the page through the cache. */
+
+struct page;
+
+/* -share-text: share read-only executable pages? */
+extern bool vm_share_text;
+
+void text_init (void);
+bool text_map (struct page *);
+bool text_copy (struct page *dst, struct page *src);
+void text_drop (struct page *);
+bool text_reclaim (void);
+void text_print_stats (void);
+
+#endif /* vm/text.h */
@@ -5,6 +5,8 @@
 
 #include <hash.h>
 #include <list.h>
+#include "vm/radix.h"
+#include <mman.h>
 
 enum vm_type {
 	/* page not initialized */
@@ -51,6 +53,9 @@ struct page {
 	/* Your implementation */
 	struct hash_elem hash_elem;	//Hash table element.
 	bool writable;			//Writable?
+	struct rmap* rmap;		//Entry in the reverse map of the frame it maps, or NULL.
+	uint8_t advice;			//Access pattern given by madvise() : MADV_NORMAL, _RANDOM or _SEQUENTIAL.
+	bool mlocked;			//Locked in memory by mlock() : its frame is never evicted.
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -64,17 +69,32 @@ struct page {
 	};
 };
 
-/* The AUX information passed to anonymous pages. */
+/* The AUX information passed to anonymous pages.
+ * Never changes once made, so fork shares it with the child's pages instead
+ * of copying it : see lazy_aux_get() and lazy_aux_put(). */
 struct lazy_aux {
 	struct file* executable;
 	size_t page_read_bytes;
 	size_t page_zero_bytes;
 	off_t offset;
 	bool next_page;		//is the NEXT page (addr + PGSIZE) also a file_page mapped to the same file?
+	int ref_cnt;		//Pages using it.
+	bool own_file;		//EXECUTABLE was opened for it, and is closed with the last reference.
 };
 
+struct lazy_aux *lazy_aux_get (struct lazy_aux *aux);
+void lazy_aux_put (struct lazy_aux *aux);
+
 struct list frame_list;	//Frame Table : List of all frames.
 
+/* Reverse map entry : one page mapping a frame. */
+struct rmap {
+	struct frame* frame;		//Frame mapped...
+	struct page* page;		//...by this page...
+	struct thread* owner;		//...of this thread.
+	struct list_elem elem;		//Element in the frame's rmap.
+};
+
 //#include "threads/thread.h"
 /* The representation of "frame" */
 struct frame {
@@ -82,8 +102,20 @@ struct frame {
 	struct page *page;
 	struct thread* owner;	//Owner of this frame.
 	struct list_elem elem;
+	struct list rmap;		//Pages mapping it : PAGE, and those sharing it copy-on-write since a fork.
+	size_t map_cnt;			//Their number.
+	struct rmap map;		//Entry for the first of them, so private frames need no malloc.
+	bool pinned;			//Being copied from : not to be evicted.
+	uint64_t ksm_sum;		//Checksum of the contents when the same-page scanner last looked.
+	bool ksm_candidate;		//Waiting in the scanner's table for an identical frame?
+	struct hash_elem ksm_elem;	//Element in that table.
 };
 
+extern struct lock frame_lock;	//Frame table lock.
+void vm_unlink_frame (struct frame *frame);
+void vm_rmap_clear (struct frame *frame, bool unmap);
+void vm_rmap_remove (struct page *page);
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -104,7 +136,8 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	struct hash hash;
+	struct radix_tree radix;	//Pages by address, unless vm_spt_hash.
+	struct hash hash;		//Pages by address, if vm_spt_hash.
 	struct thread* owner;
 };
 
@@ -118,7 +151,35 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
+/* -hugepages: back large anonymous regions with 2 MiB frames? */
+extern bool vm_huge_pages;
+
+/* -spt-hash: keep supplemental page tables in hash tables instead
+ * of radix trees? */
+extern bool vm_spt_hash;
+
+/* -kswapd-low, -kswapd-high: free user page watermarks for the
+ * background reclaim thread. */
+extern size_t vm_reclaim_low;
+extern size_t vm_reclaim_high;
+
+/* -fault-around: pages of the aligned window around a fault in a
+ * file-backed region to load along with it, or 0. */
+extern size_t vm_fault_around;
+
+/* -mlock-limit, -mlock-max: most pages mlock() may lock in one
+ * process, and in all. */
+extern size_t vm_mlock_limit;
+extern size_t vm_mlock_max;
+
 void vm_init (void);
+void vm_print_stats (void);
+void vm_exec_begin (void);
+void vm_exec_end (void);
+int vm_madvise (void *addr, size_t length, int advice);
+int vm_mlock (const void *addr, size_t length);
+void vm_populate (void *addr, size_t length);
+int vm_munlock (const void *addr, size_t length);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -131,5 +192,8 @@ bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
 void vm_dealloc_frame (struct frame* frame);
+void *vm_get_user_page (void);
+void vm_unmap_page (struct page *page);
+bool vm_zero_fill (struct page *page, void *aux);
 
 #endif  /* VM_VM_H */
@@ -23,10 +23,20 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Searches go a whole element at a time, skipping elements that
+   cannot contain what they look for and locating bits within an
+   element with a bit-scan instruction.  FIRST_FALSE lets searches
+   for false bits, which is how allocators use bitmaps, skip the
+   all-true prefix that builds up at the start of the bitmap.  It
+   is updated along with the bits but not atomically with them, so
+   callers must serialize changes against searches, as they must
+   anyway to make a search and the following change atomic. */
 struct bitmap {
 	size_t bit_cnt;     /* Number of bits. */
 	elem_type *bits;    /* Elements that represent bits. */
+	size_t first_false; /* All bits below this index are true. */
 };
 
 /* Returns the index of the element that contains the bit
@@ -62,6 +72,52 @@ last_mask (const struct bitmap *b) {
 	int last_bits = b->bit_cnt % ELEM_BITS;
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns element IDX of B with the bits that are set to VALUE
+   turned on and the rest turned off. */
+static inline elem_type
+elem_matching (const struct bitmap *b, size_t idx, bool value) {
+	return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the number of bits set in E. */
+static inline size_t
+popcount (elem_type e) {
+	e = e - ((e >> 1) & 0x5555555555555555UL);
+	e = (e & 0x3333333333333333UL) + ((e >> 2) & 0x3333333333333333UL);
+	e = (e + (e >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (e * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B at or after START, and
+   before END, that is set to VALUE, or END if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value) {
+	size_t idx, last_idx, bit_idx;
+	elem_type e;
+
+	if (start >= end)
+		return end;
+
+	idx = elem_idx (start);
+	last_idx = elem_idx (end - 1);
+	e = elem_matching (b, idx, value) & ~(bit_mask (start) - 1);
+	while (e == 0) {
+		if (++idx > last_idx)
+			return end;
+		e = elem_matching (b, idx, value);
+	}
+	bit_idx = idx * ELEM_BITS + __builtin_ctzl (e);
+	return bit_idx < end ? bit_idx : end;
+}
+
+/* Notes that the bit numbered BIT_IDX in B may have become
+   false. */
+static inline void
+note_false (struct bitmap *b, size_t bit_idx) {
+	if (bit_idx < b->first_false)
+		b->first_false = bit_idx;
+}
 
 /* Creation and destruction. */
 
@@ -75,6 +131,7 @@ bitmap_create (size_t bit_cnt) {
 	if (b != NULL) {
 		b->bit_cnt = bit_cnt;
 		b->bits = malloc (byte_cnt (bit_cnt));
+		b->first_false = 0;
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
 			return b;
@@ -95,6 +152,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED) {
 
 	b->bit_cnt = bit_cnt;
 	b->bits = (elem_type *) (b + 1);
+	b->first_false = 0;
 	bitmap_set_all (b, false);
 	return b;
 }
@@ -160,6 +218,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx) {
 	   is guaranteed to be atomic on a uniprocessor machine.  See
 	   the description of the AND instruction in [IA32-v2a]. */
 	asm ("lock andq %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+	note_false (b, bit_idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -174,6 +233,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx) {
 	   is guaranteed to be atomic on a uniprocessor machine.  See
 	   the description of the XOR instruction in [IA32-v2b]. */
 	asm ("lock xorq %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+	note_false (b, bit_idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -197,14 +257,23 @@ bitmap_set_all (struct bitmap *b, bool value) {
 /* Sets the CNT bits starting at START in B to VALUE. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	/* Bits up to an element boundary, whole elements, then the
+	   remaining bits. */
+	for (; start < end && start % ELEM_BITS != 0; start++)
+		bitmap_set (b, start, value);
+	for (; start + ELEM_BITS <= end; start += ELEM_BITS) {
+		b->bits[elem_idx (start)] = value ? (elem_type) -1 : 0;
+		if (!value)
+			note_false (b, start);
+	}
+	for (; start < end; start++)
+		bitmap_set (b, start, value);
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -218,9 +287,12 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
+	for (i = start; i < start + cnt && i % ELEM_BITS != 0; i++)
+		value_cnt += bitmap_test (b, i) == value;
+	for (; i + ELEM_BITS <= start + cnt; i += ELEM_BITS)
+		value_cnt += popcount (elem_matching (b, elem_idx (i), value));
+	for (; i < start + cnt; i++)
+		value_cnt += bitmap_test (b, i) == value;
 	return value_cnt;
 }
 
@@ -228,16 +300,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -269,15 +336,26 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
    If there is no such group, returns BITMAP_ERROR. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
+	size_t i, end;
+
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
-	if (cnt <= b->bit_cnt) {
-		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+	if (cnt == 0)
+		return start;
+	if (cnt > b->bit_cnt)
+		return BITMAP_ERROR;
+	if (!value && start < b->first_false)
+		start = b->first_false;
+
+	/* Jump from run to run of VALUE bits until one is long
+	   enough. */
+	for (i = find_next (b, start, b->bit_cnt, value);
+			i + cnt <= b->bit_cnt;
+			i = find_next (b, end, b->bit_cnt, value)) {
+		end = find_next (b, i, i + cnt, !value);
+		if (end == i + cnt)
+			return i;
 	}
 	return BITMAP_ERROR;
 }
@@ -291,9 +369,18 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    setting them. */
 size_t
 bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t idx = bitmap_scan (b, start, cnt, value);
-	if (idx != BITMAP_ERROR)
+	size_t idx;
+
+	/* Move the hint up to the first false bit while we're here. */
+	if (!value)
+		b->first_false = find_next (b, b->first_false, b->bit_cnt, false);
+
+	idx = bitmap_scan (b, start, cnt, value);
+	if (idx != BITMAP_ERROR) {
 		bitmap_set_multiple (b, idx, cnt, !value);
+		if (!value && idx == b->first_false)
+			b->first_false = idx + cnt;
+	}
 	return idx;
 }
 
@@ -315,6 +402,7 @@ bitmap_read (struct bitmap *b, struct file *file) {
 		off_t size = byte_cnt (b->bit_cnt);
 		success = file_read_at (file, b->bits, size, 0) == size;
 		b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+		b->first_false = 0;
 	}
 	return success;
 }
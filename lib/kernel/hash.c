@@ -6,18 +6,32 @@
    See hash.h for basic information. */
 
 #include "hash.h"
+#include <string.h>
 #include "../debug.h"
 #include "threads/malloc.h"
 
-#define list_elem_to_hash_elem(LIST_ELEM)                       \
-	list_entry(LIST_ELEM, struct hash_elem, list_elem)
-
-static struct list *find_bucket (struct hash *, struct hash_elem *);
-static struct hash_elem *find_elem (struct hash *, struct list *,
-		struct hash_elem *);
-static void insert_elem (struct hash *, struct list *, struct hash_elem *);
-static void remove_elem (struct hash *, struct hash_elem *);
-static void rehash (struct hash *);
+/* Table sizing.  The slot array grows when inserting would fill
+   more than 3/4 of it and shrinks when less than 1/8 of it is in
+   use, never going below MIN_SLOTS.  Every insertion or deletion
+   during a resize moves MOVE_SLOTS old slots across, which is
+   enough to finish before the new array needs to grow again.
+   If the new array cannot be allocated, the table instead goes on
+   filling its current one, up to all but one slot, and only tries
+   to grow again once that is reached. */
+#define MIN_SLOTS 8
+#define MOVE_SLOTS 8
+#define LOAD_LIMIT(SLOT_CNT) ((SLOT_CNT) / 4 * 3)
+
+static size_t find_slot (struct hash *, struct hash_slot *, size_t slot_cnt,
+		uint64_t hash, struct hash_elem *);
+static struct hash_elem *find_elem (struct hash *, struct hash_elem *,
+		uint64_t hash, bool remove);
+static bool insert_elem (struct hash *, uint64_t hash, struct hash_elem *);
+static void place (struct hash_slot *, size_t slot_cnt,
+		uint64_t hash, struct hash_elem *);
+static void remove_slot (struct hash_slot *, size_t slot_cnt, size_t idx);
+static void move_slots (struct hash *, size_t cnt);
+static bool resize (struct hash *, size_t elem_cnt);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -25,17 +39,16 @@ bool
 hash_init (struct hash *h,
 		hash_hash_func *hash, hash_less_func *less, void *aux) {
 	h->elem_cnt = 0;
-	h->bucket_cnt = 4;
-	h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+	h->slot_cnt = MIN_SLOTS;
+	h->max_elems = LOAD_LIMIT (MIN_SLOTS);
+	h->slots = calloc (h->slot_cnt, sizeof *h->slots);
+	h->old_slots = NULL;
+	h->old_slot_cnt = h->old_elem_cnt = h->old_idx = 0;
 	h->hash = hash;
 	h->less = less;
 	h->aux = aux;
 
-	if (h->buckets != NULL) {
-		hash_clear (h, NULL);
-		return true;
-	} else
-		return false;
+	return h->slots != NULL;
 }
 
 /* Removes all the elements from H.
@@ -51,18 +64,14 @@ void
 hash_clear (struct hash *h, hash_action_func *destructor) {
 	size_t i;
 
-	for (i = 0; i < h->bucket_cnt; i++) {
-		struct list *bucket = &h->buckets[i];
-
-		if (destructor != NULL)
-			while (!list_empty (bucket)) {
-				struct list_elem *list_elem = list_pop_front (bucket);
-				struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
-				destructor (hash_elem, h->aux);
-			}
+	if (destructor != NULL)
+		hash_apply (h, destructor);
 
-		list_init (bucket);
-	}
+	for (i = 0; i < h->slot_cnt; i++)
+		h->slots[i].elem = NULL;
+	free (h->old_slots);
+	h->old_slots = NULL;
+	h->old_slot_cnt = h->old_elem_cnt = h->old_idx = 0;
 
 	h->elem_cnt = 0;
 }
@@ -73,46 +82,44 @@ hash_clear (struct hash *h, hash_action_func *destructor) {
    element in the hash.  DESTRUCTOR may, if appropriate,
    deallocate the memory used by the hash element.  However,
    modifying hash table H while hash_clear() is running, using
-   any of the functions hash_clear(), hash_destroy(),
-   hash_insert(), hash_replace(), or hash_delete(), yields
-   undefined behavior, whether done in DESTRUCTOR or
-   elsewhere. */
+   any of the functions hash_clear(), hash_destroy(), hash_insert(),
+   hash_replace(), or hash_delete(), yields undefined behavior,
+   whether done in DESTRUCTOR or elsewhere. */
 void
 hash_destroy (struct hash *h, hash_action_func *destructor) {
 	if (destructor != NULL)
 		hash_clear (h, destructor);
-	free (h->buckets);
+	free (h->slots);
+	free (h->old_slots);
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
    no equal element is already in the table.
    If an equal element is already in the table, returns it
-   without inserting NEW. */
+   without inserting NEW.  If the table is full and cannot grow
+   for lack of memory, returns NEW itself without inserting it. */
 struct hash_elem *
 hash_insert (struct hash *h, struct hash_elem *new) {
-	struct list *bucket = find_bucket (h, new);
-	struct hash_elem *old = find_elem (h, bucket, new);
-
-	if (old == NULL)
-		insert_elem (h, bucket, new);
+	uint64_t hash = h->hash (new, h->aux);
+	struct hash_elem *old = find_elem (h, new, hash, false);
 
-	rehash (h);
+	if (old == NULL && !insert_elem (h, hash, new))
+		return new;
 
 	return old;
 }
 
 /* Inserts NEW into hash table H, replacing any equal element
-   already in the table, which is returned. */
+   already in the table, which is returned.  If there is none,
+   and the table is full and cannot grow for lack of memory,
+   returns NEW itself without inserting it. */
 struct hash_elem *
 hash_replace (struct hash *h, struct hash_elem *new) {
-	struct list *bucket = find_bucket (h, new);
-	struct hash_elem *old = find_elem (h, bucket, new);
+	uint64_t hash = h->hash (new, h->aux);
+	struct hash_elem *old = find_elem (h, new, hash, true);
 
-	if (old != NULL)
-		remove_elem (h, old);
-	insert_elem (h, bucket, new);
-
-	rehash (h);
+	if (!insert_elem (h, hash, new))
+		return new;
 
 	return old;
 }
@@ -121,7 +128,7 @@ hash_replace (struct hash *h, struct hash_elem *new) {
    null pointer if no equal element exists in the table. */
 struct hash_elem *
 hash_find (struct hash *h, struct hash_elem *e) {
-	return find_elem (h, find_bucket (h, e), e);
+	return find_elem (h, e, h->hash (e, h->aux), false);
 }
 
 /* Finds, removes, and returns an element equal to E in hash
@@ -133,10 +140,11 @@ hash_find (struct hash *h, struct hash_elem *e) {
    responsibility to deallocate them. */
 struct hash_elem *
 hash_delete (struct hash *h, struct hash_elem *e) {
-	struct hash_elem *found = find_elem (h, find_bucket (h, e), e);
+	struct hash_elem *found = find_elem (h, e, h->hash (e, h->aux), true);
+
 	if (found != NULL) {
-		remove_elem (h, found);
-		rehash (h);
+		move_slots (h, MOVE_SLOTS);
+		resize (h, h->elem_cnt);
 	}
 	return found;
 }
@@ -149,19 +157,13 @@ hash_delete (struct hash *h, struct hash_elem *e) {
    undefined behavior, whether done from ACTION or elsewhere. */
 void
 hash_apply (struct hash *h, hash_action_func *action) {
-	size_t i;
+	struct hash_iterator i;
 
 	ASSERT (action != NULL);
 
-	for (i = 0; i < h->bucket_cnt; i++) {
-		struct list *bucket = &h->buckets[i];
-		struct list_elem *elem, *next;
-
-		for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) {
-			next = list_next (elem);
-			action (list_elem_to_hash_elem (elem), h->aux);
-		}
-	}
+	hash_first (&i, h);
+	while (hash_next (&i))
+		action (hash_cur (&i), h->aux);
 }
 
 /* Initializes I for iterating hash table H.
@@ -187,8 +189,8 @@ hash_first (struct hash_iterator *i, struct hash *h) {
 	ASSERT (h != NULL);
 
 	i->hash = h;
-	i->bucket = i->hash->buckets;
-	i->elem = list_elem_to_hash_elem (list_head (i->bucket));
+	i->idx = SIZE_MAX;
+	i->elem = NULL;
 }
 
 /* Advances I to the next element in the hash table and returns
@@ -201,16 +203,23 @@ hash_first (struct hash_iterator *i, struct hash *h) {
    iterators. */
 struct hash_elem *
 hash_next (struct hash_iterator *i) {
+	struct hash *h;
+
 	ASSERT (i != NULL);
 
-	i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
-	while (i->elem == list_elem_to_hash_elem (list_end (i->bucket))) {
-		if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt) {
-			i->elem = NULL;
+	h = i->hash;
+	i->elem = NULL;
+	while (++i->idx < h->slot_cnt + h->old_slot_cnt) {
+		struct hash_elem *e = i->idx < h->slot_cnt
+			? h->slots[i->idx].elem
+			: h->old_slots[i->idx - h->slot_cnt].elem;
+		if (e != NULL && e != HASH_MOVED) {
+			i->elem = e;
 			break;
 		}
-		i->elem = list_elem_to_hash_elem (list_begin (i->bucket));
 	}
+	if (i->elem == NULL)
+		i->idx = h->slot_cnt + h->old_slot_cnt;
 
 	return i->elem;
 }
@@ -235,160 +244,238 @@ hash_empty (struct hash *h) {
 	return h->elem_cnt == 0;
 }
 
-/* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
-#define FNV_64_PRIME 0x00000100000001B3UL
-#define FNV_64_BASIS 0xcbf29ce484222325UL
+/* Multipliers for hash_bytes(). */
+#define HASH_MUL_1 0x9e3779b97f4a7c15ULL
+#define HASH_MUL_2 0xc2b2ae3d27d4eb4fULL
+
+/* A 64-bit word that may sit at any address. */
+typedef uint64_t __attribute__ ((__may_alias__, __aligned__ (1))) hash_word;
 
-/* Returns a hash of the SIZE bytes in BUF. */
+/* Returns a hash of the SIZE bytes in BUF.  The bytes are mixed
+   in eight at a time with a multiply and a rotate, and the result
+   is finished with hash_u64(). */
 uint64_t
 hash_bytes (const void *buf_, size_t size) {
-	/* Fowler-Noll-Vo 32-bit hash, for bytes. */
 	const unsigned char *buf = buf_;
-	uint64_t hash;
+	uint64_t hash = size * HASH_MUL_1;
+	uint64_t w;
 
 	ASSERT (buf != NULL);
 
-	hash = FNV_64_BASIS;
-	while (size-- > 0)
-		hash = (hash * FNV_64_PRIME) ^ *buf++;
+	for (; size >= sizeof w; size -= sizeof w, buf += sizeof w) {
+		w = *(const hash_word *) buf * HASH_MUL_2;
+		hash = ((hash ^ w) << 27 | (hash ^ w) >> 37) * HASH_MUL_1;
+	}
+	for (w = 0; size > 0; size--)
+		w = w << 8 | buf[size - 1];
+	hash ^= w * HASH_MUL_2;
 
-	return hash;
+	return hash_u64 (hash);
 }
 
 /* Returns a hash of string S. */
 uint64_t
-hash_string (const char *s_) {
-	const unsigned char *s = (const unsigned char *) s_;
-	uint64_t hash;
-
+hash_string (const char *s) {
 	ASSERT (s != NULL);
 
-	hash = FNV_64_BASIS;
-	while (*s != '\0')
-		hash = (hash * FNV_64_PRIME) ^ *s++;
-
-	return hash;
+	return hash_bytes (s, strlen (s));
 }
 
 /* Returns a hash of integer I. */
 uint64_t
 hash_int (int i) {
-	return hash_bytes (&i, sizeof i);
+	return hash_u64 ((unsigned) i);
 }
-
-/* Returns the bucket in H that E belongs in. */
-static struct list *
-find_bucket (struct hash *h, struct hash_elem *e) {
-	size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-	return &h->buckets[bucket_idx];
+
+/* hash_equal_func for comparing with an element through H's
+   less function, with H as AUX. */
+static bool
+equal_elems (const struct hash_elem *e, const void *key, void *h_) {
+	struct hash *h = h_;
+	const struct hash_elem *k = key;
+
+	return !h->less (e, k, h->aux) && !h->less (k, e, h->aux);
+}
+
+/* Returns the index of the slot among SLOT_CNT at SLOTS that
+   holds an element equal to E, whose hash value is HASH, or
+   SIZE_MAX if there is none. */
+static size_t
+find_slot (struct hash *h, struct hash_slot *slots, size_t slot_cnt,
+		uint64_t hash, struct hash_elem *e) {
+	return hash_probe_ (slots, slot_cnt, hash, equal_elems, e, h);
 }
 
-/* Searches BUCKET in H for a hash element equal to E.  Returns
-   it if found or a null pointer otherwise. */
+/* Searches H for an element equal to E, whose hash value is
+   HASH, and returns it, or a null pointer if there is none.  If
+   REMOVE is true, a found element is also removed. */
 static struct hash_elem *
-find_elem (struct hash *h, struct list *bucket, struct hash_elem *e) {
-	struct list_elem *i;
+find_elem (struct hash *h, struct hash_elem *e, uint64_t hash, bool remove) {
+	struct hash_elem *found;
+	size_t idx;
+
+	idx = find_slot (h, h->slots, h->slot_cnt, hash, e);
+	if (idx != SIZE_MAX) {
+		found = h->slots[idx].elem;
+		if (remove) {
+			remove_slot (h->slots, h->slot_cnt, idx);
+			h->elem_cnt--;
+		}
+		return found;
+	}
 
-	for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i)) {
-		struct hash_elem *hi = list_elem_to_hash_elem (i);
-		if (!h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
-			return hi;
+	if (h->old_slots != NULL) {
+		idx = find_slot (h, h->old_slots, h->old_slot_cnt, hash, e);
+		if (idx != SIZE_MAX) {
+			found = h->old_slots[idx].elem;
+			if (remove) {
+				/* Old slots are never shifted, so that moving them out
+				   can proceed in index order. */
+				h->old_slots[idx].elem = HASH_MOVED;
+				h->old_elem_cnt--;
+				h->elem_cnt--;
+			}
+			return found;
+		}
 	}
 	return NULL;
 }
 
-/* Returns X with its lowest-order bit set to 1 turned off. */
-static inline size_t
-turn_off_least_1bit (size_t x) {
-	return x & (x - 1);
+/* Inserts E, whose hash value is HASH, into H, which must not
+   already contain an equal element.  Returns false, without
+   inserting E, if H is full and cannot grow. */
+static bool
+insert_elem (struct hash *h, uint64_t hash, struct hash_elem *e) {
+	move_slots (h, MOVE_SLOTS);
+	if (!resize (h, h->elem_cnt + 1))
+		return false;
+	place (h->slots, h->slot_cnt, hash, e);
+	h->elem_cnt++;
+	return true;
 }
 
-/* Returns true if X is a power of 2, otherwise false. */
-static inline size_t
-is_power_of_2 (size_t x) {
-	return x != 0 && turn_off_least_1bit (x) == 0;
-}
+/* Places E, whose hash value is HASH, among the SLOT_CNT slots at
+   SLOTS, which must include an empty one. */
+static void
+place (struct hash_slot *slots, size_t slot_cnt,
+		uint64_t hash, struct hash_elem *e) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = hash & mask;
+	size_t dist = 0;
+
+	for (;; idx = (idx + 1) & mask, dist++) {
+		struct hash_slot *s = &slots[idx];
+		size_t s_dist;
+
+		if (s->elem == NULL) {
+			s->hash = hash;
+			s->elem = e;
+			return;
+		}
 
-/* Element per bucket ratios. */
-#define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
-#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
-#define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
+		/* Rob the rich: take the slot from an element that is
+		   closer to home, and go on placing that one instead. */
+		s_dist = (idx - s->hash) & mask;
+		if (s_dist < dist) {
+			struct hash_slot displaced = *s;
+			s->hash = hash;
+			s->elem = e;
+			hash = displaced.hash;
+			e = displaced.elem;
+			dist = s_dist;
+		}
+	}
+}
 
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+/* Empties slot IDX among the SLOT_CNT slots at SLOTS, shifting
+   the elements after it back by one until one is at home, so
+   that no searches stop short at the hole. */
 static void
-rehash (struct hash *h) {
-	size_t old_bucket_cnt, new_bucket_cnt;
-	struct list *new_buckets, *old_buckets;
-	size_t i;
+remove_slot (struct hash_slot *slots, size_t slot_cnt, size_t idx) {
+	size_t mask = slot_cnt - 1;
 
-	ASSERT (h != NULL);
+	for (;;) {
+		size_t next = (idx + 1) & mask;
+		struct hash_slot *s = &slots[next];
 
-	/* Save old bucket info for later use. */
-	old_buckets = h->buckets;
-	old_bucket_cnt = h->bucket_cnt;
-
-	/* Calculate the number of buckets to use now.
-	   We want one bucket for about every BEST_ELEMS_PER_BUCKET.
-	   We must have at least four buckets, and the number of
-	   buckets must be a power of 2. */
-	new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
-	if (new_bucket_cnt < 4)
-		new_bucket_cnt = 4;
-	while (!is_power_of_2 (new_bucket_cnt))
-		new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
-
-	/* Don't do anything if the bucket count wouldn't change. */
-	if (new_bucket_cnt == old_bucket_cnt)
-		return;
+		if (s->elem == NULL || ((next - s->hash) & mask) == 0)
+			break;
+		slots[idx] = *s;
+		idx = next;
+	}
+	slots[idx].elem = NULL;
+}
 
-	/* Allocate new buckets and initialize them as empty. */
-	new_buckets = malloc (sizeof *new_buckets * new_bucket_cnt);
-	if (new_buckets == NULL) {
-		/* Allocation failed.  This means that use of the hash table will
-		   be less efficient.  However, it is still usable, so
-		   there's no reason for it to be an error. */
+/* Moves the elements in up to CNT of H's old slots into its
+   current slots, and frees the old slots once they are empty. */
+static void
+move_slots (struct hash *h, size_t cnt) {
+	if (h->old_slots == NULL)
 		return;
-	}
-	for (i = 0; i < new_bucket_cnt; i++)
-		list_init (&new_buckets[i]);
-
-	/* Install new bucket info. */
-	h->buckets = new_buckets;
-	h->bucket_cnt = new_bucket_cnt;
-
-	/* Move each old element into the appropriate new bucket. */
-	for (i = 0; i < old_bucket_cnt; i++) {
-		struct list *old_bucket;
-		struct list_elem *elem, *next;
-
-		old_bucket = &old_buckets[i];
-		for (elem = list_begin (old_bucket);
-				elem != list_end (old_bucket); elem = next) {
-			struct list *new_bucket
-				= find_bucket (h, list_elem_to_hash_elem (elem));
-			next = list_next (elem);
-			list_remove (elem);
-			list_push_front (new_bucket, elem);
+
+	for (; cnt > 0 && h->old_idx < h->old_slot_cnt; cnt--, h->old_idx++) {
+		struct hash_slot *s = &h->old_slots[h->old_idx];
+
+		if (s->elem != NULL && s->elem != HASH_MOVED) {
+			place (h->slots, h->slot_cnt, s->hash, s->elem);
+			s->elem = HASH_MOVED;
+			h->old_elem_cnt--;
 		}
 	}
 
-	free (old_buckets);
+	if (h->old_idx == h->old_slot_cnt || h->old_elem_cnt == 0) {
+		free (h->old_slots);
+		h->old_slots = NULL;
+		h->old_slot_cnt = h->old_idx = 0;
+	}
 }
 
-/* Inserts E into BUCKET (in hash table H). */
-static void
-insert_elem (struct hash *h, struct list *bucket, struct hash_elem *e) {
-	h->elem_cnt++;
-	list_push_front (bucket, &e->list_elem);
-}
+/* Starts moving H to a slot array of a better size for ELEM_CNT
+   elements, if needed.  A resize still in progress is finished
+   first.  Returns false if H's current slots cannot hold ELEM_CNT
+   elements, with one slot to spare so that searches end, and no
+   larger array can be allocated. */
+static bool
+resize (struct hash *h, size_t elem_cnt) {
+	struct hash_slot *new_slots;
+	size_t new_slot_cnt;
+
+	if (elem_cnt <= h->max_elems
+			&& (elem_cnt * 8 >= h->slot_cnt || h->slot_cnt == MIN_SLOTS))
+		return true;
 
-/* Removes E from hash table H. */
-static void
-remove_elem (struct hash *h, struct hash_elem *e) {
-	h->elem_cnt--;
-	list_remove (&e->list_elem);
-}
+	/* Aim for half full. */
+	new_slot_cnt = MIN_SLOTS;
+	while (new_slot_cnt < elem_cnt * 2)
+		new_slot_cnt *= 2;
+	if (new_slot_cnt == h->slot_cnt)
+		return true;
 
+	new_slots = calloc (new_slot_cnt, sizeof *new_slots);
+	if (new_slots == NULL && new_slot_cnt > h->slot_cnt * 2) {
+		new_slot_cnt = h->slot_cnt * 2;
+		new_slots = calloc (new_slot_cnt, sizeof *new_slots);
+	}
+	if (new_slots == NULL) {
+		/* Allocation failed.  Searches get slower as the slots
+		   fill up, but the table stays usable until they are
+		   full, so raise the limit rather than trying again on
+		   every insertion. */
+		if (new_slot_cnt < h->slot_cnt)
+			return true;
+		if (elem_cnt >= h->slot_cnt)
+			return false;
+		h->max_elems = h->slot_cnt - 1;
+		return true;
+	}
+
+	move_slots (h, SIZE_MAX);
+	h->old_slots = h->slots;
+	h->old_slot_cnt = h->slot_cnt;
+	h->old_elem_cnt = h->elem_cnt;
+	h->old_idx = 0;
+	h->slots = new_slots;
+	h->slot_cnt = new_slot_cnt;
+	h->max_elems = LOAD_LIMIT (new_slot_cnt);
+	return true;
+}
@@ -0,0 +1,184 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every element is no greater
+   than its children, stored as a first child and a list of
+   siblings.  Insertion and decrease-key just "meld" a one-element
+   tree with the root, comparing the two roots and making the
+   greater one the first child of the lesser.  Removing the root
+   melds its children together in two passes, left to right in
+   pairs and then right to left, which is what bounds the
+   amortized cost of heap_pop() by O(log n); see Fredman et al.,
+   "The pairing heap: A new form of self-adjusting heap".
+
+   Each element's PREV points to its previous sibling, or to its
+   parent if it is a first child, so that any element can be cut
+   out of the tree in O(1). */
+
+/* Melds the heaps rooted at A and B, either of which may be null,
+   and returns the root of the result.  A and B must be roots,
+   without siblings. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* Make B the first child of A. */
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	b->prev = a;
+	a->child = b;
+	a->next = a->prev = NULL;
+	return a;
+}
+
+/* Melds the list of sibling trees starting at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is
+   null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *paired = NULL, *root;
+
+	/* First pass: meld siblings left to right in pairs, chaining
+	   the results in reverse through their PREV pointers. */
+	while (first != NULL) {
+		struct heap_elem *a = first, *b = first->next, *m;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		m = meld (heap, a, b);
+		m->prev = paired;
+		paired = m;
+	}
+
+	/* Second pass: meld the pairs right to left into one tree. */
+	root = NULL;
+	while (paired != NULL) {
+		struct heap_elem *m = paired;
+		paired = m->prev;
+		m->prev = NULL;
+		root = meld (heap, root, m);
+	}
+	return root;
+}
+
+/* Detaches E, which must not be the root, and its subtree from
+   the tree, leaving E a root without siblings. */
+static void
+cut (struct heap_elem *e) {
+	ASSERT (e->prev != NULL);
+
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->next = e->prev = NULL;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = meld (heap, heap->root, elem);
+	heap->size++;
+}
+
+/* Returns a least element of HEAP.  Undefined behavior if HEAP is
+   empty. */
+struct heap_elem *
+heap_top (struct heap *heap) {
+	ASSERT (!heap_empty (heap));
+	return heap->root;
+}
+
+/* Removes and returns a least element of HEAP.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top = heap_top (heap);
+
+	heap->root = merge_pairs (heap, top->child);
+	heap->size--;
+	top->child = NULL;
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+	cut (elem);
+	heap->root = meld (heap, heap->root, merge_pairs (heap, elem->child));
+	heap->size--;
+	elem->child = NULL;
+}
+
+/* Restores HEAP's order after the key of ELEM, which must be in
+   HEAP, has changed in either direction. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem != heap->root)
+		cut (elem);
+	else
+		heap->root = NULL;
+
+	/* ELEM may now be greater than its children, so put them back
+	   into the heap separately. */
+	if (elem->child != NULL) {
+		struct heap_elem *children = merge_pairs (heap, elem->child);
+		elem->child = NULL;
+		heap->root = meld (heap, heap->root, children);
+	}
+	heap->root = meld (heap, heap->root, elem);
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
@@ -0,0 +1,168 @@
+#include "lz.h"
+#include <stdbool.h>
+#include "../debug.h"
+#include "../string.h"
+
+/* Each position of the input that starts a possible match is
+   hashed on its first LZ_MIN_MATCH bytes into a table that
+   remembers the last position with that hash, plus one so that
+   zero means "none".  A candidate from the table is only a guess:
+   the bytes are compared before a match is emitted. */
+
+/* Reads four bytes at P, which need not be aligned. */
+static inline uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Hashes the four bytes V into LZ_HASH_BITS bits. */
+static inline size_t
+hash32 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the extension bytes of a nibble that was saturated at 15
+   for length LEN to *OP, which is advanced, unless that would go
+   past END.  Returns false if the output does not fit. */
+static bool
+put_length (uint8_t **op, uint8_t *end, size_t len) {
+	for (len -= 15; ; len -= 255) {
+		if (*op >= end)
+			return false;
+		if (len < 255) {
+			*(*op)++ = len;
+			return true;
+		}
+		*(*op)++ = 255;
+	}
+}
+
+/* Emits a token for the LIT_CNT literals at LIT, followed by a
+   match of MATCH_LEN bytes OFFSET bytes back, or by no match if
+   MATCH_LEN is 0.  Returns false if the output does not fit. */
+static bool
+put_sequence (uint8_t **op, uint8_t *end, const uint8_t *lit,
+		size_t lit_cnt, size_t offset, size_t match_len) {
+	size_t m = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+	uint8_t *token = *op;
+
+	if (*op >= end)
+		return false;
+	*token = (lit_cnt < 15 ? lit_cnt : 15) << 4 | (m < 15 ? m : 15);
+	(*op)++;
+	if (lit_cnt >= 15 && !put_length (op, end, lit_cnt))
+		return false;
+	if ((size_t) (end - *op) < lit_cnt)
+		return false;
+	memcpy (*op, lit, lit_cnt);
+	*op += lit_cnt;
+	if (match_len == 0)
+		return true;
+	if (end - *op < 2)
+		return false;
+	*(*op)++ = offset & 0xff;
+	*(*op)++ = offset >> 8;
+	return m < 15 || put_length (op, end, m);
+}
+
+/* Compresses the SRC_SIZE bytes at SRC, at most LZ_MAX_INPUT,
+   into the DST_SIZE bytes at DST, using the LZ_WORK_SIZE bytes at
+   WORK as scratch space.  Returns the compressed size, or 0 if it
+   would not fit in DST_SIZE bytes. */
+size_t
+lz_compress (const void *src, size_t src_size,
+		void *dst, size_t dst_size, void *work) {
+	const uint8_t *in = src;
+	uint8_t *op = dst, *end = op + dst_size;
+	uint16_t *table = work;
+	size_t ip = 0, anchor = 0;
+
+	ASSERT (src_size <= LZ_MAX_INPUT);
+
+	memset (table, 0, LZ_WORK_SIZE);
+	while (ip + LZ_MIN_MATCH <= src_size) {
+		uint32_t v = read32 (in + ip);
+		size_t h = hash32 (v);
+		size_t ref = table[h];
+		size_t len;
+
+		table[h] = ip + 1;
+		if (ref == 0 || read32 (in + ref - 1) != v) {
+			ip++;
+			continue;
+		}
+		ref--;
+		for (len = LZ_MIN_MATCH; ip + len < src_size
+				&& in[ref + len] == in[ip + len]; len++)
+			continue;
+		if (!put_sequence (&op, end, in + anchor, ip - anchor, ip - ref, len))
+			return 0;
+		ip += len;
+		anchor = ip;
+	}
+	if (!put_sequence (&op, end, in + anchor, src_size - anchor, 0, 0))
+		return 0;
+	return op - (uint8_t *) dst;
+}
+
+/* Reads the extension bytes of a length nibble that was 15 from
+   *IP, which is advanced, not going past END, and adds them to
+   *LEN.  Returns false if the input is truncated. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip >= end)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   decompressed size, or SIZE_MAX if SRC is malformed or would
+   decompress to more than DST_SIZE bytes. */
+size_t
+lz_decompress (const void *src, size_t src_size,
+		void *dst, size_t dst_size) {
+	const uint8_t *ip = src, *end = ip + src_size;
+	uint8_t *op = dst;
+	size_t out = 0;
+
+	while (ip < end) {
+		uint8_t token = *ip++;
+		size_t lit_cnt = token >> 4;
+		size_t len = token & 15;
+		size_t offset;
+
+		if (lit_cnt == 15 && !get_length (&ip, end, &lit_cnt))
+			return SIZE_MAX;
+		if ((size_t) (end - ip) < lit_cnt || dst_size - out < lit_cnt)
+			return SIZE_MAX;
+		memcpy (op + out, ip, lit_cnt);
+		ip += lit_cnt;
+		out += lit_cnt;
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return SIZE_MAX;
+		offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (len == 15 && !get_length (&ip, end, &len))
+			return SIZE_MAX;
+		len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > out || dst_size - out < len)
+			return SIZE_MAX;
+		/* The match may overlap the bytes it produces, so copy a
+		   byte at a time. */
+		for (; len > 0; len--, out++)
+			op[out] = op[out - offset];
+	}
+	return out;
+}
@@ -0,0 +1,439 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* A red-black tree is a binary search tree whose nodes are
+   colored red or black such that
+
+   1. the root is black,
+   2. a red node has no red child, and
+   3. every path from a node down to a missing child passes
+      through the same number of black nodes.
+
+   Together these keep the longest path from the root at most
+   twice as long as the shortest, so the tree's height stays
+   within 2 log2 (n + 1).  Insertion and removal restore the
+   rules with O(1) rotations and O(log n) recolorings, following
+   the algorithms in Cormen et al., "Introduction to Algorithms".
+
+   Missing children are null pointers and count as black. */
+
+static void rotate_left (struct rbtree *, struct rb_elem *);
+static void rotate_right (struct rbtree *, struct rb_elem *);
+static void insert_fixup (struct rbtree *, struct rb_elem *);
+static void remove_fixup (struct rbtree *, struct rb_elem *,
+		struct rb_elem *parent);
+static void transplant (struct rbtree *, struct rb_elem *old,
+		struct rb_elem *new);
+
+/* Returns true if E is red.  Null children are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Returns the leftmost element of the subtree rooted at E. */
+static struct rb_elem *
+leftmost (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Returns the rightmost element of the subtree rooted at E. */
+static struct rb_elem *
+rightmost (struct rb_elem *e) {
+	while (e->right != NULL)
+		e = e->right;
+	return e;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rbtree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = NULL;
+	tree->size = 0;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Returns the first (least) element of TREE, or rb_end (TREE) if
+   TREE is empty. */
+struct rb_elem *
+rb_begin (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->root != NULL ? leftmost (tree->root) : NULL;
+}
+
+/* Returns the element after ELEM in its tree.  If ELEM is the
+   last element, returns the end of the tree. */
+struct rb_elem *
+rb_next (struct rb_elem *elem) {
+	ASSERT (elem != NULL);
+
+	if (elem->right != NULL)
+		return leftmost (elem->right);
+	while (elem->parent != NULL && elem == elem->parent->right)
+		elem = elem->parent;
+	return elem->parent;
+}
+
+/* Returns TREE's end, the element just past the last one, which
+   is a null pointer. */
+struct rb_elem *
+rb_end (struct rbtree *tree UNUSED) {
+	return NULL;
+}
+
+/* Returns the last (greatest) element of TREE, for iterating in
+   reverse, or rb_rend (TREE) if TREE is empty. */
+struct rb_elem *
+rb_rbegin (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->root != NULL ? rightmost (tree->root) : NULL;
+}
+
+/* Returns the element before ELEM in its tree.  If ELEM is the
+   first element, returns the reverse end of the tree. */
+struct rb_elem *
+rb_prev (struct rb_elem *elem) {
+	ASSERT (elem != NULL);
+
+	if (elem->left != NULL)
+		return rightmost (elem->left);
+	while (elem->parent != NULL && elem == elem->parent->left)
+		elem = elem->parent;
+	return elem->parent;
+}
+
+/* Returns TREE's reverse end, the element just before the first
+   one, which is a null pointer. */
+struct rb_elem *
+rb_rend (struct rbtree *tree UNUSED) {
+	return NULL;
+}
+
+/* Inserts ELEM into TREE, after any elements equal to it. */
+void
+rb_insert (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem *parent = NULL, **link = &tree->root;
+
+	ASSERT (tree != NULL);
+	ASSERT (elem != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		link = tree->less (elem, parent, tree->aux)
+			? &parent->left : &parent->right;
+	}
+
+	elem->parent = parent;
+	elem->left = elem->right = NULL;
+	elem->red = true;
+	*link = elem;
+	tree->size++;
+
+	insert_fixup (tree, elem);
+}
+
+/* Removes ELEM from TREE and returns the element that followed
+   it, like list_remove().  Undefined behavior if ELEM is not in
+   TREE. */
+struct rb_elem *
+rb_remove (struct rbtree *tree, struct rb_elem *elem) {
+	struct rb_elem *next, *child, *parent;
+	bool removed_red;
+
+	ASSERT (tree != NULL);
+	ASSERT (elem != NULL);
+	ASSERT (tree->size > 0);
+
+	next = rb_next (elem);
+	if (elem->left == NULL || elem->right == NULL) {
+		/* ELEM has at most one child, which takes its place. */
+		child = elem->left != NULL ? elem->left : elem->right;
+		parent = elem->parent;
+		removed_red = elem->red;
+		transplant (tree, elem, child);
+	} else {
+		/* ELEM's successor NEXT has no left child.  Move it into
+		   ELEM's place, taking ELEM's color, so that in effect it
+		   is NEXT's old position that disappears. */
+		child = next->right;
+		removed_red = next->red;
+		if (next->parent == elem)
+			parent = next;
+		else {
+			parent = next->parent;
+			transplant (tree, next, child);
+			next->right = elem->right;
+			next->right->parent = next;
+		}
+		transplant (tree, elem, next);
+		next->left = elem->left;
+		next->left->parent = next;
+		next->red = elem->red;
+	}
+	tree->size--;
+
+	if (!removed_red)
+		remove_fixup (tree, child, parent);
+	return next;
+}
+
+/* Removes and returns the first element of TREE, which must not
+   be empty. */
+struct rb_elem *
+rb_pop_front (struct rbtree *tree) {
+	struct rb_elem *front = rb_front (tree);
+	rb_remove (tree, front);
+	return front;
+}
+
+/* Removes and returns the last element of TREE, which must not
+   be empty. */
+struct rb_elem *
+rb_pop_back (struct rbtree *tree) {
+	struct rb_elem *back = rb_back (tree);
+	rb_remove (tree, back);
+	return back;
+}
+
+/* Returns the first element of TREE.  Undefined behavior if TREE
+   is empty. */
+struct rb_elem *
+rb_front (struct rbtree *tree) {
+	ASSERT (!rb_empty (tree));
+	return leftmost (tree->root);
+}
+
+/* Returns the last element of TREE.  Undefined behavior if TREE
+   is empty. */
+struct rb_elem *
+rb_back (struct rbtree *tree) {
+	ASSERT (!rb_empty (tree));
+	return rightmost (tree->root);
+}
+
+/* Returns the first element of TREE equal to KEY, or a null
+   pointer if there is none.  KEY need not be in TREE; typically
+   it is a local structure with just the sort key filled in. */
+struct rb_elem *
+rb_find (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = rb_lower_bound (tree, key);
+
+	if (e != NULL && !tree->less (key, e, tree->aux))
+		return e;
+	return NULL;
+}
+
+/* Returns the first element of TREE that is not less than KEY,
+   or rb_end (TREE) if there is none. */
+struct rb_elem *
+rb_lower_bound (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root, *bound = NULL;
+
+	ASSERT (key != NULL);
+
+	while (e != NULL)
+		if (tree->less (e, key, tree->aux))
+			e = e->right;
+		else {
+			bound = e;
+			e = e->left;
+		}
+	return bound;
+}
+
+/* Returns the first element of TREE that is greater than KEY, or
+   rb_end (TREE) if there is none. */
+struct rb_elem *
+rb_upper_bound (struct rbtree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root, *bound = NULL;
+
+	ASSERT (key != NULL);
+
+	while (e != NULL)
+		if (tree->less (key, e, tree->aux)) {
+			bound = e;
+			e = e->left;
+		} else
+			e = e->right;
+	return bound;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->size;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (struct rbtree *tree) {
+	ASSERT (tree != NULL);
+	return tree->root == NULL;
+}
+
+/* Puts NEW, which may be null, in OLD's place under OLD's parent.
+   OLD's own links are left alone. */
+static void
+transplant (struct rbtree *tree, struct rb_elem *old, struct rb_elem *new) {
+	if (old->parent == NULL)
+		tree->root = new;
+	else if (old == old->parent->left)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+/* Rotates the subtree rooted at E to the left, making E's right
+   child its root:
+
+       E                R
+      / \              / \
+     a   R     =>     E   c
+        / \          / \
+       b   c        a   b
+*/
+static void
+rotate_left (struct rbtree *tree, struct rb_elem *e) {
+	struct rb_elem *r = e->right;
+
+	e->right = r->left;
+	if (r->left != NULL)
+		r->left->parent = e;
+	transplant (tree, e, r);
+	r->left = e;
+	e->parent = r;
+}
+
+/* Rotates the subtree rooted at E to the right, the mirror image
+   of rotate_left(). */
+static void
+rotate_right (struct rbtree *tree, struct rb_elem *e) {
+	struct rb_elem *l = e->left;
+
+	e->left = l->right;
+	if (l->right != NULL)
+		l->right->parent = e;
+	transplant (tree, e, l);
+	l->right = e;
+	e->parent = l;
+}
+
+/* Restores the red-black rules after inserting red element E,
+   which may now be the red child of a red parent. */
+static void
+insert_fixup (struct rbtree *tree, struct rb_elem *e) {
+	while (is_red (e->parent)) {
+		struct rb_elem *parent = e->parent;
+		struct rb_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct rb_elem *uncle = grand->right;
+			if (is_red (uncle)) {
+				/* Push the grandparent's blackness down a level and
+				   continue from the grandparent. */
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->right) {
+				rotate_left (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_right (tree, grand);
+		} else {
+			struct rb_elem *uncle = grand->left;
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->left) {
+				rotate_right (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_left (tree, grand);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the red-black rules after removing a black element
+   whose place was taken by E, which may be null, under PARENT.
+   Paths through E are one black element short. */
+static void
+remove_fixup (struct rbtree *tree, struct rb_elem *e, struct rb_elem *parent) {
+	while (e != tree->root && !is_red (e)) {
+		if (e == parent->left) {
+			struct rb_elem *sib = parent->right;
+			if (is_red (sib)) {
+				sib->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				sib = parent->right;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				/* Take a black level off the sibling's side too and
+				   move the shortage up to the parent. */
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sib->right)) {
+				sib->left->red = false;
+				sib->red = true;
+				rotate_right (tree, sib);
+				sib = parent->right;
+			}
+			sib->red = parent->red;
+			parent->red = false;
+			sib->right->red = false;
+			rotate_left (tree, parent);
+		} else {
+			struct rb_elem *sib = parent->left;
+			if (is_red (sib)) {
+				sib->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				sib = parent->left;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sib->left)) {
+				sib->right->red = false;
+				sib->red = true;
+				rotate_left (tree, sib);
+				sib = parent->left;
+			}
+			sib->red = parent->red;
+			parent->red = false;
+			sib->left->red = false;
+			rotate_right (tree, parent);
+		}
+		e = tree->root;
+	}
+	if (e != NULL)
+		e->red = false;
+}
@@ -0,0 +1,25 @@
+#ifndef TESTS_BENCH_H
+#define TESTS_BENCH_H
+
+#include <stdint.h>
+
+/* Helpers for benchmark programs.
+
+   A benchmark prints timings instead of checking results, so it
+   is built along with the tests but is not part of `make check'.
+   Run one by hand from a build directory, e.g.
+
+     make tests/vm/bench-tlb-walk.output
+
+   and read the numbers out of the .output file. */
+
+/* Returns the processor's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+#endif /* tests/bench.h */
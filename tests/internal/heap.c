@@ -0,0 +1,167 @@
+/* Test program for lib/kernel/heap.c.
+
+   Fills heaps of various sizes in random order and checks that
+   they empty in sorted order, including after removing elements
+   from the middle and changing their keys in place.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a heap that we will test. */
+#define MAX_SIZE 64
+
+/* A heap element. */
+struct value 
+  {
+    struct heap_elem elem;      /* Heap element. */
+    int value;                  /* Item value. */
+    bool in_heap;               /* Still in the heap? */
+  };
+
+static void shuffle (struct value[], size_t);
+static bool value_less (const struct heap_elem *, const struct heap_elem *,
+                        void *);
+static void verify_heap (struct heap *, struct value[], int size);
+
+/* Test the pairing heap implementation. */
+void
+test (void) 
+{
+  int size;
+
+  printf ("testing various size heaps:");
+  for (size = 0; size < MAX_SIZE; size++) 
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++) 
+        {
+          static struct value values[MAX_SIZE];
+          struct heap heap;
+          int i, removed;
+
+          /* Put values 0...SIZE in random order in VALUES. */
+          for (i = 0; i < size; i++)
+            values[i].value = i;
+          shuffle (values, size);
+
+          /* Fill the heap, checking the top as we go, then check
+             that it empties in order. */
+          heap_init (&heap, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              int min = i == 0 ? values[0].value
+                : heap_entry (heap_top (&heap), struct value, elem)->value;
+              heap_push (&heap, &values[i].elem);
+              values[i].in_heap = true;
+              ASSERT (heap_size (&heap) == (size_t) i + 1);
+              ASSERT (heap_entry (heap_top (&heap), struct value, elem)->value
+                      == (values[i].value < min ? values[i].value : min));
+            }
+          verify_heap (&heap, values, size);
+
+          /* Refill, pop a few to give the heap some structure, then
+             remove a random third of the rest from the middle. */
+          shuffle (values, size);
+          for (i = 0; i < size; i++)
+            {
+              heap_push (&heap, &values[i].elem);
+              values[i].in_heap = true;
+            }
+          for (i = 0; i < size / 4; i++)
+            heap_entry (heap_pop (&heap), struct value, elem)->in_heap = false;
+          removed = 0;
+          for (i = 0; i < size; i++)
+            if (values[i].in_heap && random_ulong () % 3 == 0)
+              {
+                heap_remove (&heap, &values[i].elem);
+                values[i].in_heap = false;
+                removed++;
+              }
+          ASSERT (heap_size (&heap) == (size_t) (size - size / 4 - removed));
+          verify_heap (&heap, values, size);
+
+          /* Refill, pop one, then give every element a new random
+             key, some larger and some smaller. */
+          for (i = 0; i < size; i++)
+            {
+              heap_push (&heap, &values[i].elem);
+              values[i].in_heap = true;
+            }
+          if (size > 0)
+            heap_entry (heap_pop (&heap), struct value, elem)->in_heap = false;
+          for (i = 0; i < size; i++)
+            if (values[i].in_heap)
+              {
+                values[i].value = random_ulong () % (MAX_SIZE * 2);
+                heap_update (&heap, &values[i].elem);
+              }
+          verify_heap (&heap, values, size);
+          ASSERT (heap_empty (&heap));
+        }
+    }
+  
+  printf (" done\n");
+  printf ("heap: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value *array, size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = heap_entry (a_, struct value, elem);
+  const struct value *b = heap_entry (b_, struct value, elem);
+  
+  return a->value < b->value;
+}
+
+/* Verifies that popping everything from HEAP yields exactly the
+   elements of the SIZE-element array VALUES that are marked as
+   in the heap, in nondecreasing order. */
+static void
+verify_heap (struct heap *heap, struct value values[], int size) 
+{
+  int i, cnt = 0, prev = -1;
+
+  for (i = 0; i < size; i++)
+    cnt += values[i].in_heap;
+  ASSERT (heap_size (heap) == (size_t) cnt);
+
+  while (!heap_empty (heap))
+    {
+      struct value *v = heap_entry (heap_pop (heap), struct value, elem);
+      ASSERT (v->in_heap);
+      ASSERT (v->value >= prev);
+      v->in_heap = false;
+      prev = v->value;
+      cnt--;
+    }
+  ASSERT (cnt == 0);
+  ASSERT (heap_size (heap) == 0);
+}
@@ -0,0 +1,105 @@
+/* Test program for lib/kernel/lz.c.
+
+   Compresses pages of various kinds of data, from all zeros to
+   random bytes, and checks that they decompress to what went in,
+   that output buffers that are too small are refused, and that
+   damaged input is rejected or at least stays in bounds.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <lz.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Size of the largest input we will test. */
+#define MAX_SIZE 4096
+
+/* Kinds of input. */
+enum kind
+  {
+    ZEROS,                      /* All zeros. */
+    RANDOM,                     /* Random bytes. */
+    SMALL,                      /* Random bytes from a small alphabet. */
+    REPEATS,                    /* Mostly copies of recent bytes. */
+    KIND_CNT
+  };
+
+static void fill (uint8_t *, size_t, enum kind);
+
+/* Test the LZ codec. */
+void
+test (void)
+{
+  static uint8_t in[MAX_SIZE], out[MAX_SIZE];
+  static uint8_t comp[MAX_SIZE * 2], work[LZ_WORK_SIZE];
+  int kind;
+
+  printf ("testing compression:");
+  for (kind = 0; kind < KIND_CNT; kind++)
+    {
+      size_t size;
+
+      printf (" %d", kind);
+      for (size = 0; size <= MAX_SIZE; size += 1 + random_ulong () % 97)
+        {
+          size_t comp_size, out_size;
+
+          fill (in, size, kind);
+
+          /* Round trip. */
+          comp_size = lz_compress (in, size, comp, sizeof comp, work);
+          ASSERT (comp_size > 0 && comp_size <= sizeof comp);
+          out_size = lz_decompress (comp, comp_size, out, sizeof out);
+          ASSERT (out_size == size);
+          ASSERT (!memcmp (in, out, size));
+          if (kind == ZEROS && size == MAX_SIZE)
+            ASSERT (comp_size < 64);
+
+          /* Too little room, either way. */
+          ASSERT (lz_compress (in, size, comp, comp_size - 1, work) == 0);
+          if (size > 0)
+            ASSERT (lz_decompress (comp, comp_size, out, size - 1)
+                    == SIZE_MAX);
+
+          /* Damage.  Whatever comes out must fit. */
+          comp_size = lz_compress (in, size, comp, sizeof comp, work);
+          comp[random_ulong () % comp_size] ^= 1 + random_ulong () % 255;
+          out_size = lz_decompress (comp, comp_size, out, sizeof out);
+          ASSERT (out_size == SIZE_MAX || out_size <= sizeof out);
+        }
+    }
+
+  printf (" done\n");
+  printf ("lz: PASS\n");
+}
+
+/* Fills the SIZE bytes at BUF with data of the given KIND. */
+static void
+fill (uint8_t *buf, size_t size, enum kind kind)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    switch (kind)
+      {
+      case ZEROS:
+        buf[i] = 0;
+        break;
+      case RANDOM:
+        buf[i] = random_ulong ();
+        break;
+      case SMALL:
+        buf[i] = random_ulong () % 4;
+        break;
+      default:
+        buf[i] = i > 8 && random_ulong () % 8 != 0
+                 ? buf[i - 1 - random_ulong () % 8] : random_ulong ();
+        break;
+      }
+}
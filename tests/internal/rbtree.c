@@ -0,0 +1,286 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Builds trees of various sizes in random order, with and
+   without duplicates, and checks the red-black invariants and
+   the traversal, search and removal functions after every
+   change.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value 
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int value;                  /* Item value. */
+    int seq;                    /* Insertion order. */
+  };
+
+static void shuffle (struct value[], size_t);
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_subtree (struct rbtree *, struct rb_elem *);
+static void verify_tree (struct rbtree *, int size);
+static void verify_tree_bkwd (struct rbtree *, int size);
+
+/* Test the red-black tree implementation. */
+void
+test (void) 
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++) 
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++) 
+        {
+          static struct value values[MAX_SIZE * 4];
+          static int order[MAX_SIZE * 4];
+          struct rbtree tree;
+          struct rb_elem *e;
+          struct value key;
+          int i, ofs;
+
+          /* Put values 0...SIZE in random order in VALUES. */
+          for (i = 0; i < size; i++)
+            values[i].value = i;
+          shuffle (values, size);
+
+          /* Assemble tree, checking it after each insertion. */
+          rb_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              rb_insert (&tree, &values[i].elem);
+              ASSERT (rb_size (&tree) == (size_t) i + 1);
+              verify_subtree (&tree, tree.root);
+            }
+          verify_tree (&tree, size);
+          verify_tree_bkwd (&tree, size);
+
+          /* Verify search. */
+          for (i = -1; i <= size; i++)
+            {
+              key.value = i;
+              e = rb_find (&tree, &key.elem);
+              ASSERT (i >= 0 && i < size
+                      ? rb_entry (e, struct value, elem)->value == i
+                      : e == NULL);
+              e = rb_lower_bound (&tree, &key.elem);
+              ASSERT (size > 0 && i < size
+                      ? rb_entry (e, struct value, elem)->value
+                        == (i < 0 ? 0 : i)
+                      : e == rb_end (&tree));
+              e = rb_upper_bound (&tree, &key.elem);
+              ASSERT (i + 1 < size
+                      ? rb_entry (e, struct value, elem)->value == i + 1
+                      : e == rb_end (&tree));
+            }
+
+          /* Remove the odd values while iterating, then the even
+             ones from both ends. */
+          for (e = rb_begin (&tree); e != rb_end (&tree); )
+            if (rb_entry (e, struct value, elem)->value % 2)
+              {
+                e = rb_remove (&tree, e);
+                verify_subtree (&tree, tree.root);
+              }
+            else
+              e = rb_next (e);
+          ASSERT (rb_size (&tree) == (size_t) (size + 1) / 2);
+          for (i = 0; !rb_empty (&tree); i++)
+            {
+              struct value *v;
+              if (i % 2 == 0)
+                {
+                  v = rb_entry (rb_pop_front (&tree), struct value, elem);
+                  ASSERT (v->value % 2 == 0);
+                }
+              else
+                {
+                  v = rb_entry (rb_pop_back (&tree), struct value, elem);
+                  ASSERT (v->value % 2 == 0);
+                }
+              verify_subtree (&tree, tree.root);
+            }
+          ASSERT (rb_begin (&tree) == rb_end (&tree));
+
+          /* Insert values with random duplicates in random order,
+             then verify that equal values keep insertion order. */
+          ofs = 0;
+          for (i = 0; i < size; i++)
+            {
+              int copies = random_ulong () % 4 + 1;
+              while (copies-- > 0)
+                values[ofs++].value = i;
+            }
+          ASSERT ((size_t) ofs <= sizeof values / sizeof *values);
+          shuffle (values, ofs);
+          for (i = 0; i < ofs; i++)
+            {
+              values[i].seq = i;
+              rb_insert (&tree, &values[i].elem);
+            }
+          verify_subtree (&tree, tree.root);
+          for (e = rb_begin (&tree), i = 0; e != rb_end (&tree);
+               e = rb_next (e), i++)
+            {
+              struct rb_elem *next = rb_next (e);
+              if (next != rb_end (&tree))
+                {
+                  struct value *a = rb_entry (e, struct value, elem);
+                  struct value *b = rb_entry (next, struct value, elem);
+                  ASSERT (a->value < b->value
+                          || (a->value == b->value && a->seq < b->seq));
+                }
+            }
+          ASSERT (i == ofs);
+
+          /* rb_find() returns the first of several equal values. */
+          for (i = 0; i < size; i++)
+            {
+              struct rb_elem *prev;
+              key.value = i;
+              e = rb_find (&tree, &key.elem);
+              ASSERT (rb_entry (e, struct value, elem)->value == i);
+              prev = rb_prev (e);
+              ASSERT (prev == rb_rend (&tree)
+                      || rb_entry (prev, struct value, elem)->value < i);
+            }
+
+          /* Remove everything in random order.  The elements are
+             in the tree, so shuffle their indexes, not VALUES. */
+          for (i = 0; i < ofs; i++)
+            order[i] = i;
+          for (i = 0; i < ofs; i++)
+            {
+              int j = i + random_ulong () % (ofs - i);
+              int t = order[j];
+              order[j] = order[i];
+              order[i] = t;
+            }
+          for (i = 0; i < ofs; i++)
+            {
+              rb_remove (&tree, &values[order[i]].elem);
+              verify_subtree (&tree, tree.root);
+            }
+          ASSERT (rb_empty (&tree) && rb_size (&tree) == 0);
+        }
+    }
+  
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value *array, size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+  
+  return a->value < b->value;
+}
+
+/* Verifies the links, ordering and coloring of the subtree of
+   TREE rooted at E, and returns its black height.  Passing the
+   root also checks that the root is black. */
+static int
+verify_subtree (struct rbtree *tree, struct rb_elem *e) 
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  if (e == tree->root)
+    ASSERT (e->parent == NULL && !e->red);
+  if (e->left != NULL)
+    {
+      ASSERT (e->left->parent == e);
+      ASSERT (!value_less (e, e->left, NULL));
+      ASSERT (!e->red || !e->left->red);
+    }
+  if (e->right != NULL)
+    {
+      ASSERT (e->right->parent == e);
+      ASSERT (!value_less (e->right, e, NULL));
+      ASSERT (!e->red || !e->right->red);
+    }
+
+  left = verify_subtree (tree, e->left);
+  right = verify_subtree (tree, e->right);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE contains the values 0...SIZE when traversed
+   in forward order. */
+static void
+verify_tree (struct rbtree *tree, int size) 
+{
+  struct rb_elem *e;
+  int i;
+  
+  for (i = 0, e = rb_begin (tree);
+       i < size && e != rb_end (tree);
+       i++, e = rb_next (e)) 
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (i == v->value);
+    }
+  ASSERT (i == size);
+  ASSERT (e == rb_end (tree));
+  ASSERT (size == 0
+          || rb_entry (rb_front (tree), struct value, elem)->value == 0);
+}
+
+/* Verifies that TREE contains the values SIZE...0 when traversed
+   in reverse order. */
+static void
+verify_tree_bkwd (struct rbtree *tree, int size) 
+{
+  struct rb_elem *e;
+  int i;
+
+  for (i = size - 1, e = rb_rbegin (tree);
+       i >= 0 && e != rb_rend (tree);
+       i--, e = rb_prev (e)) 
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (i == v->value);
+    }
+  ASSERT (i == -1);
+  ASSERT (e == rb_rend (tree));
+  ASSERT (size == 0
+          || rb_entry (rb_back (tree), struct value, elem)->value == size - 1);
+}
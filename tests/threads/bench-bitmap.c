@@ -0,0 +1,119 @@
+/* Measures bitmap searches on a large, mostly full bitmap: a
+   single free bit, a run of free bits, and a series of
+   allocations with bitmap_scan_and_flip() that each have to get
+   past everything allocated before them.  A bit-at-a-time search
+   is timed alongside for reference.
+
+   This is a benchmark, not a test: it is not run by `make check'.
+   Run it from a build directory with
+
+     make tests/threads/bench-bitmap.output */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+
+/* Bitmap size and the fraction of it, in 1/1024ths, left free. */
+#define BIT_CNT (1024 * 1024)
+#define FREE_PER_1024 8
+
+/* Ticks to spend on each measurement. */
+#define BENCH_TICKS 20
+
+static struct bitmap *map;
+static volatile size_t sink;
+
+/* Returns the first run of CNT false bits in MAP at or after
+   START, testing one bit at a time. */
+static size_t
+naive_scan (size_t start, size_t cnt)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= BIT_CNT; i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (map, i + j))
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Waits for the start of a timer tick and returns it. */
+static int64_t
+start_tick (void)
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_ticks () == start)
+    continue;
+  return timer_ticks ();
+}
+
+/* Prints how many searches for CNT false bits in MAP, with
+   bitmap_scan() or naive_scan() as NAIVE says, complete per
+   second. */
+static void
+measure_scan (const char *name, size_t cnt, bool naive)
+{
+  int64_t start = start_tick (), ticks;
+  long long n = 0;
+
+  do
+    {
+      sink += naive ? naive_scan (0, cnt) : bitmap_scan (map, 0, cnt, false);
+      n++;
+    }
+  while ((ticks = timer_elapsed (start)) < BENCH_TICKS);
+  msg ("%-24s %lld scans/s", name, n * TIMER_FREQ / ticks);
+}
+
+/* Marks most of MAP as in use, leaving scattered free bits and a
+   few short free runs. */
+static void
+fill_map (void)
+{
+  size_t i;
+
+  random_init (0);
+  bitmap_set_all (map, true);
+  for (i = 0; i < BIT_CNT * FREE_PER_1024 / 1024; i++)
+    bitmap_reset (map, BIT_CNT / 2 + random_ulong () % (BIT_CNT / 2));
+  bitmap_set_multiple (map, BIT_CNT - 64, 64, false);
+}
+
+void
+test_bench_bitmap (void)
+{
+  int64_t start, ticks;
+  size_t allocs;
+
+  map = bitmap_create (BIT_CNT);
+  if (map == NULL)
+    fail ("out of memory");
+  msg ("%d bits, about %d/1024 free in the upper half",
+       BIT_CNT, FREE_PER_1024 * 2);
+
+  fill_map ();
+  measure_scan ("first free bit", 1, false);
+  measure_scan ("first free bit, naive", 1, true);
+  measure_scan ("first 64 free bits", 64, false);
+  measure_scan ("first 64 free bits, naive", 64, true);
+
+  /* Allocate every free bit, one at a time. */
+  fill_map ();
+  start = start_tick ();
+  for (allocs = 0; bitmap_scan_and_flip (map, 0, 1, false) != BITMAP_ERROR;
+       allocs++)
+    continue;
+  ticks = timer_elapsed (start);
+  msg ("allocated %zu bits one at a time in %lld ticks",
+       allocs, (long long) ticks);
+
+  bitmap_destroy (map);
+  pass ();
+}
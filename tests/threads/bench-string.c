@@ -0,0 +1,114 @@
+/* Measures the throughput of memcpy(), memset(), memcmp() and
+   strlen() for a range of block sizes, next to a bytewise copy
+   loop for reference.  Each measurement repeats the operation for
+   a fixed number of timer ticks, so the figures are only as good
+   as the timer's resolution allows.
+
+   This is a benchmark, not a test: it is not run by `make check'.
+   Run it from a build directory with
+
+     make tests/threads/bench-string.output */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Largest block size, and the buffers' size in pages. */
+#define MAX_SIZE (1024 * 1024)
+#define BUF_PAGES (MAX_SIZE / PGSIZE)
+
+/* Ticks to spend on each measurement. */
+#define BENCH_TICKS 20
+
+static const size_t sizes[] = { 64, 256, 1024, 4096, 65536, MAX_SIZE };
+
+enum op { OP_BYTEWISE, OP_MEMCPY, OP_MEMSET, OP_MEMCMP, OP_STRLEN, OP_CNT };
+static const char *op_names[OP_CNT] =
+  { "bytewise", "memcpy", "memset", "memcmp", "strlen" };
+
+static uint8_t *src, *dst;
+static volatile size_t sink;
+
+/* Performs OP once on SIZE bytes. */
+static void
+run_op (enum op op, size_t size)
+{
+  size_t i;
+
+  switch (op)
+    {
+    case OP_BYTEWISE:
+      for (i = 0; i < size; i++)
+        dst[i] = src[i];
+      break;
+    case OP_MEMCPY:
+      memcpy (dst, src, size);
+      break;
+    case OP_MEMSET:
+      memset (dst, op, size);
+      break;
+    case OP_MEMCMP:
+      sink += memcmp (dst, src, size);
+      break;
+    case OP_STRLEN:
+      sink += strlen ((char *) src + MAX_SIZE - size);
+      break;
+    default:
+      break;
+    }
+}
+
+/* Prints the throughput of OP on SIZE-byte blocks. */
+static void
+measure (enum op op, size_t size)
+{
+  uint64_t bytes = 0, mbps;
+  int64_t start, ticks;
+
+  /* Start on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+
+  start = timer_ticks ();
+  do
+    {
+      run_op (op, size);
+      bytes += size;
+    }
+  while ((ticks = timer_elapsed (start)) < BENCH_TICKS);
+
+  mbps = bytes * TIMER_FREQ / ticks / 1000000;
+  msg ("%-8s %7zu bytes: %llu.%02llu GB/s",
+       op_names[op], size, mbps / 1000, mbps % 1000 / 10);
+}
+
+void
+test_bench_string (void)
+{
+  enum op op;
+  size_t k;
+
+  src = palloc_get_multiple (PAL_ZERO, BUF_PAGES + 1);
+  dst = palloc_get_multiple (PAL_ZERO, BUF_PAGES + 1);
+  if (src == NULL || dst == NULL)
+    fail ("out of memory");
+
+  /* Equal blocks for memcmp(), and a terminated string of every
+     size ending at the top of SRC for strlen(). */
+  memset (src, 'x', MAX_SIZE);
+  memset (dst, 'x', MAX_SIZE);
+  src[MAX_SIZE] = '\0';
+
+  for (op = 0; op < OP_CNT; op++)
+    for (k = 0; k < sizeof sizes / sizeof *sizes; k++)
+      measure (op, sizes[k]);
+
+  palloc_free_multiple (src, BUF_PAGES + 1);
+  palloc_free_multiple (dst, BUF_PAGES + 1);
+  pass ();
+}
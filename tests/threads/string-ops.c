@@ -0,0 +1,128 @@
+/* Checks memcpy(), memmove(), memset(), memcmp() and strlen()
+   against bytewise reference loops, for every combination of
+   source and destination alignment within a word and for sizes
+   on both sides of the point where they switch to the string
+   instructions. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+
+#define BUF_SIZE 1200
+
+static uint8_t src[BUF_SIZE], dst[BUF_SIZE], ref[BUF_SIZE];
+
+static const size_t sizes[] =
+  { 0, 1, 7, 8, 9, 15, 16, 63, 255, 256, 257, 300, 1000, 1024 };
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+static void fill (uint8_t *, size_t, uint8_t seed);
+static void check_same (const char *op, size_t size, int s_ofs, int d_ofs);
+
+void
+test_string_ops (void)
+{
+  size_t i, k;
+  int s_ofs, d_ofs;
+
+  msg ("memcpy");
+  for (k = 0; k < SIZE_CNT; k++)
+    for (s_ofs = 0; s_ofs < 8; s_ofs++)
+      for (d_ofs = 0; d_ofs < 8; d_ofs++)
+        {
+          fill (src, BUF_SIZE, k + s_ofs);
+          fill (dst, BUF_SIZE, 0x55);
+          memcpy (ref, dst, BUF_SIZE);
+          for (i = 0; i < sizes[k]; i++)
+            ref[d_ofs + i] = src[s_ofs + i];
+          if (memcpy (dst + d_ofs, src + s_ofs, sizes[k]) != dst + d_ofs)
+            fail ("memcpy returned the wrong pointer");
+          check_same ("memcpy", sizes[k], s_ofs, d_ofs);
+        }
+
+  msg ("memmove");
+  for (k = 0; k < SIZE_CNT; k++)
+    for (s_ofs = 0; s_ofs < 16; s_ofs++)
+      for (d_ofs = 0; d_ofs < 16; d_ofs++)
+        {
+          /* Overlapping blocks within DST. */
+          fill (dst, BUF_SIZE, k + d_ofs);
+          memcpy (ref, dst, BUF_SIZE);
+          for (i = 0; i < sizes[k]; i++)
+            src[i] = ref[s_ofs + i];
+          for (i = 0; i < sizes[k]; i++)
+            ref[d_ofs + i] = src[i];
+          if (memmove (dst + d_ofs, dst + s_ofs, sizes[k]) != dst + d_ofs)
+            fail ("memmove returned the wrong pointer");
+          check_same ("memmove", sizes[k], s_ofs, d_ofs);
+        }
+
+  msg ("memset");
+  for (k = 0; k < SIZE_CNT; k++)
+    for (d_ofs = 0; d_ofs < 8; d_ofs++)
+      {
+        fill (dst, BUF_SIZE, k);
+        memcpy (ref, dst, BUF_SIZE);
+        for (i = 0; i < sizes[k]; i++)
+          ref[d_ofs + i] = 0xa7;
+        if (memset (dst + d_ofs, 0x3a7, sizes[k]) != dst + d_ofs)
+          fail ("memset returned the wrong pointer");
+        check_same ("memset", sizes[k], 0, d_ofs);
+      }
+
+  msg ("memcmp");
+  for (k = 1; k < SIZE_CNT; k++)
+    for (s_ofs = 0; s_ofs < 8; s_ofs++)
+      {
+        size_t size = sizes[k];
+
+        fill (src, BUF_SIZE, k);
+        memcpy (dst + s_ofs, src, size);
+        if (memcmp (dst + s_ofs, src, size) != 0)
+          fail ("memcmp of %zu equal bytes is nonzero", size);
+        for (i = 0; i < size; i += size / 5 + 1)
+          {
+            dst[s_ofs + i] = src[i] + 1;
+            if (memcmp (dst + s_ofs, src, size) <= 0
+                || memcmp (src, dst + s_ofs, size) >= 0)
+              fail ("memcmp missed byte %zu of %zu", i, size);
+            dst[s_ofs + i] = src[i];
+          }
+      }
+
+  msg ("strlen");
+  for (k = 0; k < SIZE_CNT; k++)
+    for (s_ofs = 0; s_ofs < 8; s_ofs++)
+      {
+        memset (src, 'x', BUF_SIZE);
+        src[s_ofs + sizes[k]] = '\0';
+        if (strlen ((char *) src + s_ofs) != sizes[k])
+          fail ("strlen of %zu-byte string at offset %d returned %zu",
+                sizes[k], s_ofs, strlen ((char *) src + s_ofs));
+      }
+
+  pass ();
+}
+
+/* Fills the SIZE bytes at BUF with a pattern derived from SEED. */
+static void
+fill (uint8_t *buf, size_t size, uint8_t seed)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = seed * 31 + i * 7 + (i >> 8);
+}
+
+/* Fails unless DST matches REF everywhere. */
+static void
+check_same (const char *op, size_t size, int s_ofs, int d_ofs)
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    if (dst[i] != ref[i])
+      fail ("%s of %zu bytes from offset %d to %d: byte %zu is %d, not %d",
+            op, size, s_ofs, d_ofs, i, dst[i], ref[i]);
+}
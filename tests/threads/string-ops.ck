@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(string-ops) begin
+(string-ops) memcpy
+(string-ops) memmove
+(string-ops) memset
+(string-ops) memcmp
+(string-ops) strlen
+(string-ops) PASS
+(string-ops) end
+pass;
@@ -38,6 +38,10 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"vmalloc-frag", test_vmalloc_frag},
+    {"string-ops", test_string_ops},
+    {"bench-string", test_bench_string},
+    {"bench-bitmap", test_bench_bitmap},
   };
 
 static const char *test_name;
@@ -32,6 +32,10 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_vmalloc_frag;
+extern test_func test_string_ops;
+extern test_func test_bench_string;
+extern test_func test_bench_bitmap;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
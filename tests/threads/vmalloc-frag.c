@@ -0,0 +1,144 @@
+/* Fragments the kernel pool so that no two free pages are
+   physically adjacent, then checks that a multi-page malloc()
+   and a direct vmalloc() still succeed, that the memory they
+   return is usable end to end, and that freeing it gives every
+   page back to the pool. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/* Size of the large allocations, in pages. */
+#define BIG_PAGES 32
+
+static void *fragment_pool (void);
+static void release_pool (void *);
+static size_t count_free_pages (void);
+static void check_pattern (uint8_t *, size_t, uint8_t seed);
+
+void
+test_vmalloc_frag (void)
+{
+  size_t free_before, free_after;
+  uint8_t *buf;
+  void *held;
+
+  free_before = count_free_pages ();
+
+  msg ("fragmenting kernel pool");
+  held = fragment_pool ();
+  if (palloc_get_multiple (0, 2) != NULL)
+    fail ("found two physically contiguous free pages");
+
+  msg ("malloc of %d pages", BIG_PAGES);
+  buf = malloc (BIG_PAGES * PGSIZE);
+  if (buf == NULL)
+    fail ("malloc failed on a fragmented pool");
+  if (!is_vmalloc_vaddr (buf))
+    fail ("malloc did not fall back to vmalloc");
+  check_pattern (buf, BIG_PAGES * PGSIZE, 0x5a);
+  free (buf);
+
+  msg ("vmalloc of %d zeroed pages", BIG_PAGES);
+  buf = vmalloc (PAL_ZERO, BIG_PAGES);
+  if (buf == NULL)
+    fail ("vmalloc failed on a fragmented pool");
+  for (size_t i = 0; i < BIG_PAGES * PGSIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of zeroed vmalloc block is %d", i, buf[i]);
+  check_pattern (buf, BIG_PAGES * PGSIZE, 0xa5);
+  vfree (buf);
+
+  msg ("vmalloc larger than the free pool");
+  buf = vmalloc (0, free_before);
+  if (buf != NULL)
+    fail ("vmalloc of %zu pages succeeded with half of them in use",
+          free_before);
+
+  release_pool (held);
+
+  /* Page-table pages for the vmalloc range stay allocated once
+     built, so allow for a handful of them. */
+  free_after = count_free_pages ();
+  if (free_after + 8 < free_before)
+    fail ("leaked %zu pages", free_before - free_after);
+  pass ();
+}
+
+/* Allocates every free kernel page, then frees every other one,
+   leaving the pool with no two adjacent free pages.  Returns the
+   pages still held, chained through their first word. */
+static void *
+fragment_pool (void)
+{
+  void *all = NULL, *held = NULL;
+  void *page;
+
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = all;
+      all = page;
+    }
+
+  while (all != NULL)
+    {
+      void *next = *(void **) all;
+      if (pg_no (all) % 2 == 0)
+        palloc_free_page (all);
+      else
+        {
+          *(void **) all = held;
+          held = all;
+        }
+      all = next;
+    }
+  return held;
+}
+
+/* Frees the chain of pages returned by fragment_pool(). */
+static void
+release_pool (void *held)
+{
+  while (held != NULL)
+    {
+      void *next = *(void **) held;
+      palloc_free_page (held);
+      held = next;
+    }
+}
+
+/* Returns the number of pages the kernel pool can hand out right
+   now, leaving the pool as it found it. */
+static size_t
+count_free_pages (void)
+{
+  void *all = NULL, *page;
+  size_t cnt = 0;
+
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = all;
+      all = page;
+      cnt++;
+    }
+  release_pool (all);
+  return cnt;
+}
+
+/* Fills the SIZE bytes at BUF with a pattern derived from SEED
+   and reads it back. */
+static void
+check_pattern (uint8_t *buf, size_t size, uint8_t seed)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = seed ^ (i * 7) ^ (i >> 12);
+  for (i = 0; i < size; i++)
+    if (buf[i] != (uint8_t) (seed ^ (i * 7) ^ (i >> 12)))
+      fail ("byte %zu reads back %d", i, buf[i]);
+}
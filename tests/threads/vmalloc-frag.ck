@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vmalloc-frag) begin
+(vmalloc-frag) fragmenting kernel pool
+(vmalloc-frag) malloc of 32 pages
+(vmalloc-frag) vmalloc of 32 zeroed pages
+(vmalloc-frag) vmalloc larger than the free pool
+(vmalloc-frag) PASS
+(vmalloc-frag) end
+pass;
@@ -0,0 +1,53 @@
+/* Measures fork on a process with a large heap.
+
+   Writes to every page of the first half of a large array in the
+   bss, which gives each of those a frame, and leaves the rest
+   untouched.  Then forks a child that exits at once, several
+   times, and reports the average cost of fork() in the parent in
+   TSC cycles.  The resident half is shared copy-on-write and the
+   untouched half is copied as lazy pages, so the cost is that of
+   copying the address space, not its contents.  The kernel's
+   "Fork:" statistics line gives the time spent in the copy:
+
+     make tests/vm/bench-fork.output */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define PAGES (SIZE / PAGE_SIZE)
+#define FORKS 8
+
+static char array[SIZE];
+
+void
+test_main (void)
+{
+  uint64_t start, cycles = 0;
+  size_t i;
+  int n;
+
+  for (i = 0; i < SIZE / 2; i += PAGE_SIZE)
+    array[i] = 1;
+
+  for (n = 0; n < FORKS; n++)
+    {
+      pid_t pid;
+
+      start = rdtsc ();
+      pid = fork ("child");
+      if (pid == 0)
+        exit (0);
+      cycles += rdtsc () - start;
+      if (pid < 0)
+        fail ("fork failed");
+      if (wait (pid) != 0)
+        fail ("child did not exit cleanly");
+    }
+  msg ("fork: %d pages (%d resident), %d forks, %llu cycles/fork",
+       PAGES, PAGES / 2, FORKS, cycles / FORKS);
+}
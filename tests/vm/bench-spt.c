@@ -0,0 +1,54 @@
+/* Measures supplemental page table lookups.
+
+   First touches every page of a large array, so that each access
+   takes a page fault that looks the page up, and reports the
+   average cost of a fault in TSC cycles.  Then passes a buffer
+   spanning the whole array to write() on a bad file descriptor,
+   which validates the buffer one byte at a time against the
+   supplemental page table before failing, and reports the cost
+   per validated byte.  Comparing the default radix tree against
+   the hash table backend:
+
+     make tests/vm/bench-spt.output
+     make tests/vm/bench-spt.output KERNELFLAGS=-spt-hash */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define PAGES (SIZE / PAGE_SIZE)
+#define ROUNDS 3
+
+static char array[SIZE];
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  size_t i;
+  int round;
+
+  start = rdtsc ();
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    array[i] = 1;
+  cycles = rdtsc () - start;
+  msg ("touch: %d faults, %llu cycles, %llu cycles/fault",
+       PAGES, cycles, cycles / PAGES);
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      int result;
+
+      start = rdtsc ();
+      result = write (0x1234, array, SIZE);
+      cycles = rdtsc () - start;
+      if (result != -1)
+        fail ("write to bad fd returned %d", result);
+      msg ("round %d: %d bytes validated, %llu cycles, %llu cycles/byte",
+           round, SIZE, cycles, cycles / SIZE);
+    }
+}
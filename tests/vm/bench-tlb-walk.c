@@ -0,0 +1,53 @@
+/* Measures TLB reach with a random walk over a large array.
+
+   Every page of the array is touched once so that page faults are
+   out of the way, then the array is read at pseudo-random offsets
+   and the average cost of a read is reported in TSC cycles.  The
+   array is 2 MiB aligned, so comparing a normal run against one
+   with huge pages shows what 2 MiB mappings buy:
+
+     make tests/vm/bench-tlb-walk.output
+     make tests/vm/bench-tlb-walk.output KERNELFLAGS=-hugepages */
+
+#include <stdint.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 1024 * 1024)
+#define WORDS (SIZE / sizeof (uint64_t))
+#define STEPS (1024 * 1024)
+#define ROUNDS 3
+
+static uint64_t array[WORDS] __attribute__ ((aligned (2 * 1024 * 1024)));
+
+void
+test_main (void)
+{
+  uint64_t x = 1, sum = 0;
+  size_t i;
+  int round;
+
+  msg ("touch %d MiB", SIZE / (1024 * 1024));
+  for (i = 0; i < WORDS; i += 4096 / sizeof (uint64_t))
+    array[i] = i;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      uint64_t start, cycles;
+
+      start = rdtsc ();
+      for (i = 0; i < STEPS; i++)
+        {
+          x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+          sum += array[(x >> 33) % WORDS];
+        }
+      cycles = rdtsc () - start;
+      msg ("round %d: %d reads, %llu cycles, %llu cycles/read",
+           round, STEPS, cycles, cycles / STEPS);
+    }
+
+  /* Keep SUM live. */
+  if (sum == 1)
+    msg ("unlikely sum");
+}
@@ -0,0 +1,47 @@
+/* Measures faults on untouched anonymous memory.
+
+   First reads one byte from every page of a large array in the
+   bss, which the kernel can serve by mapping its shared zero page,
+   and reports the average cost of a fault in TSC cycles.  Then
+   writes to every page of the first quarter, which gives each of
+   those a frame of its own, and reports the same.  The array is
+   larger than the user pool, so without the zero page the read
+   pass alone has to swap:
+
+     make tests/vm/bench-zero.output */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/bench.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (32 * 1024 * 1024)
+#define PAGE_SIZE 4096
+#define PAGES (SIZE / PAGE_SIZE)
+
+static char array[SIZE];
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  size_t i;
+  int sum = 0;
+
+  start = rdtsc ();
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    sum += array[i];
+  cycles = rdtsc () - start;
+  if (sum != 0)
+    fail ("untouched memory is not zero");
+  msg ("read: %d faults, %llu cycles, %llu cycles/fault",
+       PAGES, cycles, cycles / PAGES);
+
+  start = rdtsc ();
+  for (i = 0; i < SIZE / 4; i += PAGE_SIZE)
+    array[i] = 1;
+  cycles = rdtsc () - start;
+  msg ("write: %d faults, %llu cycles, %llu cycles/fault",
+       PAGES / 4, cycles, cycles / (PAGES / 4));
+}
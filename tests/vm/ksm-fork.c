@@ -0,0 +1,78 @@
+/* Fills pages with identical contents and gives ksmd time to merge
+   them, then forks.  Writes to the merged pages, in the child and
+   then in the parent, must each land in a private copy: neither
+   process may see the other's writes, and the pages not written to
+   must keep their contents. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT 32
+#define ROUNDS 256
+
+static char pages[PAGE_COUNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+/* Checks that page I is filled with C. */
+static void
+check_page (size_t i, char c)
+{
+  const char *page = pages + i * PAGE_SIZE;
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    if (page[ofs] != c)
+      fail ("byte %zu of page %zu has value %02hhx (should be %02hhx)",
+            ofs, i, page[ofs], c);
+}
+
+/* Fills page I with C. */
+static void
+fill_page (size_t i, char c)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    pages[i * PAGE_SIZE + ofs] = c;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+  int round;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    fill_page (i, 'k');
+  msg ("fill %d identical pages", PAGE_COUNT);
+
+  /* Only read the pages for a while, so that they hold still long
+     enough for ksmd to merge them. */
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < PAGE_COUNT; i++)
+      check_page (i, 'k');
+  msg ("pages read back while ksmd runs");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      fill_page (0, 'c');
+      check_page (0, 'c');
+      for (i = 1; i < PAGE_COUNT; i++)
+        check_page (i, 'k');
+      msg ("child wrote to a merged page");
+      return;
+    }
+  wait (child);
+  check_page (0, 'k');
+  msg ("parent does not see the child's write");
+
+  fill_page (1, 'p');
+  check_page (1, 'p');
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (i != 1)
+      check_page (i, 'k');
+  msg ("parent wrote to a merged page");
+}
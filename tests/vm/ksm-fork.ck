@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-fork) begin
+(ksm-fork) fill 32 identical pages
+(ksm-fork) pages read back while ksmd runs
+(ksm-fork) child wrote to a merged page
+(ksm-fork) end
+(ksm-fork) parent does not see the child's write
+(ksm-fork) parent wrote to a merged page
+(ksm-fork) end
+EOF
+
+# The pages must really have been merged before the fork, and the
+# parent's write must have taken its page out of the sharing.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($ksm) = grep (/^KSM: \d+ pages merged/, @output);
+fail "missing \"KSM\" statistics line\n" if !defined $ksm;
+my ($merged, $unmerged) = $ksm =~ /^KSM: (\d+) pages merged, (\d+) unmerged/;
+fail "no pages were merged\n" if $merged == 0;
+fail "no merged page was written to\n" if $unmerged == 0;
+pass;
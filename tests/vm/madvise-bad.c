@@ -0,0 +1,24 @@
+/* Passes bad arguments to madvise(), which must return -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[2 * 4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  CHECK (madvise (buf + 1, 4096, MADV_NORMAL) == -1,
+         "try to madvise a misaligned address");
+  CHECK (madvise (buf, 0, MADV_NORMAL) == -1,
+         "try to madvise zero bytes");
+  CHECK (madvise (buf, 4096, 99) == -1,
+         "try to madvise with bad advice");
+  CHECK (madvise (buf, 4096, -1) == -1,
+         "try to madvise with negative advice");
+  CHECK (madvise ((void *) 0x10000000, 4096, MADV_WILLNEED) == -1,
+         "try to madvise unmapped memory");
+  CHECK (madvise ((void *) 0x8004000000, 4096, MADV_DONTNEED) == -1,
+         "try to madvise kernel memory");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-bad) begin
+(madvise-bad) try to madvise a misaligned address
+(madvise-bad) try to madvise zero bytes
+(madvise-bad) try to madvise with bad advice
+(madvise-bad) try to madvise with negative advice
+(madvise-bad) try to madvise unmapped memory
+(madvise-bad) try to madvise kernel memory
+(madvise-bad) end
+madvise-bad: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Writes to pages of the bss, the data segment and a file mapping,
+   and drops them with MADV_DONTNEED.  Afterward the bss must read as
+   zeros and the others as the contents of their files again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define INIT "Initialized data"
+
+static char zeros[2 * 4096] __attribute__ ((aligned (4096)));
+static char data[4096] __attribute__ ((aligned (4096))) = INIT;
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  size_t i;
+
+  memset (zeros, 'z', sizeof zeros);
+  CHECK (madvise (zeros, sizeof zeros, MADV_DONTNEED) == 0,
+         "madvise bss MADV_DONTNEED");
+  for (i = 0; i < sizeof zeros; i++)
+    if (zeros[i] != 0)
+      fail ("byte %zu of bss has value %02hhx (should be 0)", i, zeros[i]);
+
+  strlcpy (data, "Overwritten", sizeof data);
+  CHECK (madvise (data, sizeof data, MADV_DONTNEED) == 0,
+         "madvise data MADV_DONTNEED");
+  CHECK (!strcmp (data, INIT), "data is back to \"%s\"", INIT);
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 0, handle, 0) != MAP_FAILED, "mmap \"sample.txt\"");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  CHECK (madvise (actual, 4096, MADV_DONTNEED) == 0,
+         "madvise mmap'd file MADV_DONTNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file after MADV_DONTNEED reported bad data");
+
+  munmap (actual);
+  close (handle);
+}
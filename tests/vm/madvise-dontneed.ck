@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) madvise bss MADV_DONTNEED
+(madvise-dontneed) madvise data MADV_DONTNEED
+(madvise-dontneed) data is back to "Initialized data"
+(madvise-dontneed) open "sample.txt"
+(madvise-dontneed) mmap "sample.txt"
+(madvise-dontneed) madvise mmap'd file MADV_DONTNEED
+(madvise-dontneed) end
+EOF
+pass;
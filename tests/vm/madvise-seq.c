@@ -0,0 +1,42 @@
+/* Maps a file larger than memory can comfortably hold, advises
+   MADV_SEQUENTIAL on it, and reads it through twice.  Pages read ahead
+   and pages dropped behind the reader must both read correctly, and
+   the .ck checks that pages were in fact read ahead. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/large.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+check_mapping (const char *actual, size_t size, int pass)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < size; ofs += 4096)
+    {
+      size_t len = size - ofs < 4096 ? size - ofs : 4096;
+      if (memcmp (actual + ofs, large + ofs, len))
+        fail ("pass %d: page at offset %zu of mmap'd file reported bad data",
+              pass, ofs);
+    }
+  msg ("pass %d: validated", pass);
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  size_t size = sizeof large - 1;
+  int handle;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (mmap (actual, size, 0, handle, 0) != MAP_FAILED, "mmap \"large.txt\"");
+  CHECK (madvise (actual, size, MADV_SEQUENTIAL) == 0,
+         "madvise MADV_SEQUENTIAL");
+  check_mapping (actual, size, 1);
+  check_mapping (actual, size, 2);
+  munmap (actual);
+  close (handle);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-seq) begin
+(madvise-seq) open "large.txt"
+(madvise-seq) mmap "large.txt"
+(madvise-seq) madvise MADV_SEQUENTIAL
+(madvise-seq) pass 1: validated
+(madvise-seq) pass 2: validated
+(madvise-seq) end
+EOF
+
+# Without -fault-around, only MADV_SEQUENTIAL loads pages around a
+# file fault, so some must have been.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($faults) = grep (/^File faults: /, @output);
+fail "missing \"File faults\" statistics line\n" if !defined $faults;
+my ($around) = $faults =~ /, (\d+) more pages loaded around them$/;
+fail "no pages were read ahead of the sequential reader\n"
+  if !defined $around || $around == 0;
+pass;
@@ -0,0 +1,42 @@
+/* Writes to pages of the bss, then advises MADV_WILLNEED on them and
+   on a file mapping not yet read.  Neither may change. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+static char buf[SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+  CHECK (madvise (buf, SIZE, MADV_WILLNEED) == 0, "madvise bss MADV_WILLNEED");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu of bss has value %02hhx (should be %02hhx)",
+            i, buf[i], (char) (i % 251));
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 0, handle, 0) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (madvise (actual, 4096, MADV_WILLNEED) == 0,
+         "madvise mmap'd file MADV_WILLNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  for (i = strlen (sample); i < 4096; i++)
+    if (actual[i] != 0)
+      fail ("byte %zu of mmap'd region has value %02hhx (should be 0)",
+            i, actual[i]);
+
+  munmap (actual);
+  close (handle);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-willneed) begin
+(madvise-willneed) madvise bss MADV_WILLNEED
+(madvise-willneed) open "sample.txt"
+(madvise-willneed) mmap "sample.txt"
+(madvise-willneed) madvise mmap'd file MADV_WILLNEED
+(madvise-willneed) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Runs with -mlock-limit=16 -mlock-max=32, so that at most two
+   processes' worth of pages may be locked at once.  Locked pages must
+   be given back by munlock(), and by exit() for a process that never
+   called it: children that lock up to the limit and exit must not
+   stop the ones after them from doing the same. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LIMIT 16
+#define CHILD_CNT 6
+
+static char buf[LIMIT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  int i;
+
+  CHECK (mlock (buf, sizeof buf) == 0, "mlock %d pages", LIMIT);
+  CHECK (munlock (buf, sizeof buf) == 0, "munlock %d pages", LIMIT);
+  CHECK (mlock (buf, sizeof buf) == 0, "mlock %d pages again", LIMIT);
+  CHECK (munlock (buf, sizeof buf) == 0, "munlock %d pages again", LIMIT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child = fork ("child");
+      if (child == 0)
+        exit (mlock (buf, sizeof buf));
+      CHECK (wait (child) == 0, "child %d locked %d pages and exited", i, LIMIT);
+    }
+
+  CHECK (mlock (buf, sizeof buf) == 0, "mlock %d pages after the children", LIMIT);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-exit) begin
+(mlock-exit) mlock 16 pages
+(mlock-exit) munlock 16 pages
+(mlock-exit) mlock 16 pages again
+(mlock-exit) munlock 16 pages again
+(mlock-exit) child 0 locked 16 pages and exited
+(mlock-exit) child 1 locked 16 pages and exited
+(mlock-exit) child 2 locked 16 pages and exited
+(mlock-exit) child 3 locked 16 pages and exited
+(mlock-exit) child 4 locked 16 pages and exited
+(mlock-exit) child 5 locked 16 pages and exited
+(mlock-exit) mlock 16 pages after the children
+(mlock-exit) end
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Runs with -mlock-limit=16.  mlock() of more pages than that, at
+   once or a few at a time, must return -1, and pages already locked
+   must not count twice. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LIMIT 16
+
+static char buf[(LIMIT + 1) * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  CHECK (mlock (buf, sizeof buf) == -1, "try to mlock %d pages", LIMIT + 1);
+  CHECK (mlock (buf, LIMIT * PAGE_SIZE) == 0, "mlock %d pages", LIMIT);
+  CHECK (mlock (buf, LIMIT * PAGE_SIZE) == 0, "mlock the same %d pages again", LIMIT);
+  CHECK (mlock (buf + LIMIT * PAGE_SIZE, PAGE_SIZE) == -1,
+         "try to mlock one page more");
+  CHECK (munlock (buf, PAGE_SIZE) == 0, "munlock one page");
+  CHECK (mlock (buf + LIMIT * PAGE_SIZE, PAGE_SIZE) == 0,
+         "mlock one page more");
+  CHECK (mlock ((void *) 0x10000000, PAGE_SIZE) == -1,
+         "try to mlock unmapped memory");
+  CHECK (mlock (buf, 0) == -1, "try to mlock zero bytes");
+  CHECK (munlock (buf, sizeof buf) == 0, "munlock all pages");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlock-limit) begin
+(mlock-limit) try to mlock 17 pages
+(mlock-limit) mlock 16 pages
+(mlock-limit) mlock the same 16 pages again
+(mlock-limit) try to mlock one page more
+(mlock-limit) munlock one page
+(mlock-limit) mlock one page more
+(mlock-limit) try to mlock unmapped memory
+(mlock-limit) try to mlock zero bytes
+(mlock-limit) munlock all pages
+(mlock-limit) end
+mlock-limit: exit(0)
+EOF
+pass;
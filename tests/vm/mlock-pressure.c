@@ -0,0 +1,53 @@
+/* Locks a few pages with mlock(), then writes to far more memory
+   than Pintos has, so that everything else is swapped out.  The
+   locked pages must keep their contents, and munlock() must then
+   let them go.  Since they would read back correctly from swap too,
+   the .ck checks that eviction passed over their frames. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LOCKED_SIZE (16 * PAGE_SIZE)
+#define CHUNK_SIZE (16 * 1024 * 1024)
+
+static char locked[LOCKED_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char big_chunk[CHUNK_SIZE];
+
+static void
+check_locked (void)
+{
+  size_t i;
+
+  for (i = 0; i < LOCKED_SIZE; i++)
+    if (locked[i] != (char) (i % 253))
+      fail ("byte %zu of locked memory has value %02hhx (should be %02hhx)",
+            i, locked[i], (char) (i % 253));
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  for (i = 0; i < LOCKED_SIZE; i++)
+    locked[i] = i % 253;
+  CHECK (mlock (locked, LOCKED_SIZE) == 0, "mlock %d pages", LOCKED_SIZE / PAGE_SIZE);
+
+  msg ("write sparsely over %d MB", CHUNK_SIZE / (1024 * 1024));
+  for (i = 0; i < CHUNK_SIZE / PAGE_SIZE; i++)
+    big_chunk[i * PAGE_SIZE] = i;
+  for (i = 0; i < CHUNK_SIZE / PAGE_SIZE; i++)
+    if (big_chunk[i * PAGE_SIZE] != (char) i)
+      fail ("data is inconsistent");
+  check_locked ();
+  msg ("locked memory is intact");
+
+  CHECK (munlock (locked, LOCKED_SIZE) == 0, "munlock %d pages", LOCKED_SIZE / PAGE_SIZE);
+  for (i = 0; i < CHUNK_SIZE / PAGE_SIZE; i++)
+    big_chunk[i * PAGE_SIZE] = ~i;
+  check_locked ();
+  msg ("unlocked memory is intact");
+}
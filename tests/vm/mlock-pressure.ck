@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-pressure) begin
+(mlock-pressure) mlock 16 pages
+(mlock-pressure) write sparsely over 16 MB
+(mlock-pressure) locked memory is intact
+(mlock-pressure) munlock 16 pages
+(mlock-pressure) unlocked memory is intact
+(mlock-pressure) end
+EOF
+
+# The locked pages stay in memory because eviction skips their frames,
+# which it must have come across while writing out everything else.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($stats) = grep (/^mlock: /, @output);
+fail "missing \"mlock\" statistics line\n" if !defined $stats;
+my ($skipped) = $stats =~ /(\d+) locked frames passed over by eviction$/;
+fail "eviction never passed over a locked frame\n"
+  if !defined $skipped || $skipped == 0;
+pass;
@@ -0,0 +1,54 @@
+/* Maps anonymous memory and writes to it, then forks.  The child
+   must see the parent's data and be able to unmap its copy of the
+   mapping, which must leave the parent's alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096)
+
+static void
+check_pattern (const char *p, char c)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != (char) (c + i / 4096))
+      fail ("byte %zu of the mapping has value %02hhx (should be %02hhx)",
+            i, p[i], (char) (c + i / 4096));
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  pid_t child;
+  size_t i;
+
+  CHECK (mmap (actual, SIZE, 1 | MAP_ANONYMOUS, -1, 0) != MAP_FAILED,
+         "mmap anonymous");
+  for (i = 0; i < SIZE; i++)
+    actual[i] = 'a' + i / 4096;
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      check_pattern (actual, 'a');
+      msg ("child sees the parent's data");
+      munmap (actual);
+      msg ("munmap in child");
+      CHECK (mmap (actual, SIZE, 1 | MAP_ANONYMOUS, -1, 0) != MAP_FAILED,
+             "mmap anonymous again in child");
+      for (i = 0; i < SIZE; i++)
+        if (actual[i] != 0)
+          fail ("byte %zu of the new mapping has value %02hhx (should be 0)",
+                i, actual[i]);
+      return;
+    }
+  wait (child);
+  check_pattern (actual, 'a');
+  msg ("parent's data is unchanged");
+  munmap (actual);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon-fork) begin
+(mmap-anon-fork) mmap anonymous
+(mmap-anon-fork) child sees the parent's data
+(mmap-anon-fork) munmap in child
+(mmap-anon-fork) mmap anonymous again in child
+(mmap-anon-fork) end
+(mmap-anon-fork) parent's data is unchanged
+(mmap-anon-fork) end
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Maps anonymous memory, which must read as zeros and be writable,
+   then unmaps it and maps it again, zero-filled anew. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096)
+
+static void
+check_zeros (const char *p)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of the mapping has value %02hhx (should be 0)",
+            i, p[i]);
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  void *map;
+  size_t i;
+
+  CHECK ((map = mmap (actual, SIZE, 1 | MAP_ANONYMOUS, -1, 0)) == actual,
+         "mmap anonymous");
+  check_zeros (actual);
+  msg ("mapping is zero-filled");
+
+  for (i = 0; i < SIZE; i++)
+    actual[i] = i % 251;
+  for (i = 0; i < SIZE; i++)
+    if (actual[i] != (char) (i % 251))
+      fail ("byte %zu of the mapping has value %02hhx (should be %02hhx)",
+            i, actual[i], (char) (i % 251));
+  msg ("mapping is writable");
+
+  munmap (map);
+  CHECK ((map = mmap (actual, SIZE, 1 | MAP_ANONYMOUS, -1, 0)) == actual,
+         "mmap anonymous again");
+  check_zeros (actual);
+  msg ("new mapping is zero-filled");
+  munmap (map);
+}
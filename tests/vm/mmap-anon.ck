@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap anonymous
+(mmap-anon) mapping is zero-filled
+(mmap-anon) mapping is writable
+(mmap-anon) mmap anonymous again
+(mmap-anon) new mapping is zero-filled
+(mmap-anon) end
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Passes bad file descriptor and offset combinations with the
+   MAP_ANONYMOUS and MAP_POPULATE flags, which must make mmap()
+   fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  void *addr = (void *) 0x10000000;
+  int handle;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (mmap (addr, 4096, 1 | MAP_ANONYMOUS, handle, 0) == MAP_FAILED,
+         "try to mmap anonymous with a file");
+  CHECK (mmap (addr, 4096, 1 | MAP_ANONYMOUS, -1, 0x1000) == MAP_FAILED,
+         "try to mmap anonymous with an offset");
+  CHECK (mmap (addr, 0, 1 | MAP_ANONYMOUS, -1, 0) == MAP_FAILED,
+         "try to mmap anonymous with zero length");
+  CHECK (mmap (addr, 4096, MAP_POPULATE, 0x5678, 0) == MAP_FAILED,
+         "try to mmap populate with a bad fd");
+  CHECK (mmap (addr, 4096, MAP_POPULATE, handle, 0x1234) == MAP_FAILED,
+         "try to mmap populate with a misaligned offset");
+}
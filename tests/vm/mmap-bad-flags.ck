@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-bad-flags) begin
+(mmap-bad-flags) open "large.txt"
+(mmap-bad-flags) try to mmap anonymous with a file
+(mmap-bad-flags) try to mmap anonymous with an offset
+(mmap-bad-flags) try to mmap anonymous with zero length
+(mmap-bad-flags) try to mmap populate with a bad fd
+(mmap-bad-flags) try to mmap populate with a misaligned offset
+(mmap-bad-flags) end
+mmap-bad-flags: exit(0)
+EOF
+pass;
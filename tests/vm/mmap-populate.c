@@ -0,0 +1,28 @@
+/* Maps a file with MAP_POPULATE, which loads the pages at once.  The
+   mapping must read as the file, whole pages and the partial last
+   one alike. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/large.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 4096 + 100)
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  void *map;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK ((map = mmap (actual, SIZE, MAP_POPULATE, handle, 0)) != MAP_FAILED,
+         "mmap \"large.txt\" with MAP_POPULATE");
+  close (handle);
+  if (memcmp (actual, large, SIZE))
+    fail ("read of mmap'd file reported bad data");
+  msg ("mapping matches the file");
+  munmap (map);
+}
@@ -0,0 +1,43 @@
+/* Runs child-linear 8 times, at most 3 at once, starting a new one
+   whenever the oldest exits, so that processes keep mapping text
+   that exiting ones leave behind.  Every child must run correctly,
+   and once they are all gone no text may stay shared. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+#define RUNNING_CNT 3
+
+/* Starts a child-linear process and returns its pid. */
+static pid_t
+spawn (void)
+{
+  pid_t pid = fork ("child-linear");
+
+  if (pid == 0)
+    {
+      exec ("child-linear");
+      fail ("failed to exec child-linear");
+    }
+  return pid;
+}
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < RUNNING_CNT; i++)
+    children[i] = spawn ();
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      if (wait (children[i]) != 0x42)
+        fail ("child %d returned the wrong value", i);
+      if (i + RUNNING_CNT < CHILD_CNT)
+        children[i + RUNNING_CNT] = spawn ();
+    }
+  msg ("%d children ran correctly", CHILD_CNT);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(share-text) begin
+(share-text) 8 children ran correctly
+(share-text) end
+EOF
+
+# Children started while others ran must have found text cached, and
+# with every process gone, nothing may be left in the cache.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($text) = grep (/^Text: /, @output);
+fail "missing \"Text\" statistics line\n" if !defined $text;
+my ($frames, $pages, $cached) = $text
+  =~ /^Text: (\d+) shared frames mapped by (\d+) pages; \d+ loaded, (\d+) found cached/;
+fail "malformed \"Text\" statistics line\n" if !defined $cached;
+fail "no child found text cached by another\n" if $cached == 0;
+fail "$frames frames mapped by $pages pages still shared after exit\n"
+  if $frames != 0 || $pages != 0;
+pass;
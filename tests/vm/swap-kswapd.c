@@ -0,0 +1,77 @@
+/* Writes to more memory than Pintos has, with kswapd told to keep
+   plenty of memory free, then reads it back and rewrites it several
+   times in different orders, so that pages are swapped back in
+   while kswapd is writing others out, and written to just after
+   coming back in.  Every page must keep the data last written to
+   it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (16 * 1024 * 1024)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+#define PASSES 3
+
+static char big_chunk[CHUNK_SIZE];
+
+/* Returns the byte page I should hold at its start and end after
+   PASS passes over it. */
+static char
+value (size_t i, int pass)
+{
+  return (char) (i * 7 + pass);
+}
+
+/* Checks that page I holds the bytes of pass PASS, then rewrites
+   it for the next one. */
+static void
+check_and_rewrite (size_t i, int pass)
+{
+  char *page = big_chunk + i * PAGE_SIZE;
+
+  if (page[0] != value (i, pass) || page[PAGE_SIZE - 1] != value (i, pass))
+    fail ("pass %d: page %zu has %02hhx and %02hhx (should be %02hhx)",
+          pass, i, page[0], page[PAGE_SIZE - 1], value (i, pass));
+  page[0] = page[PAGE_SIZE - 1] = value (i, pass + 1);
+}
+
+void
+test_main (void)
+{
+  size_t i;
+  int pass;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    big_chunk[i * PAGE_SIZE] = big_chunk[i * PAGE_SIZE + PAGE_SIZE - 1]
+      = value (i, 0);
+  msg ("write %d MB", CHUNK_SIZE / (1024 * 1024));
+
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      switch (pass % 3)
+        {
+        case 0:
+          for (i = 0; i < PAGE_COUNT; i++)
+            check_and_rewrite (i, pass);
+          break;
+        case 1:
+          for (i = PAGE_COUNT; i-- > 0; )
+            check_and_rewrite (i, pass);
+          break;
+        case 2:
+          /* Every 17th page, which is coprime to PAGE_COUNT, so
+             that each page is visited once. */
+          for (i = 0; i < PAGE_COUNT; i++)
+            check_and_rewrite (i * 17 % PAGE_COUNT, pass);
+          break;
+        }
+      msg ("pass %d: data is consistent", pass);
+    }
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (big_chunk[i * PAGE_SIZE] != value (i, PASSES))
+      fail ("page %zu lost its last write", i);
+  msg ("last writes are intact");
+}
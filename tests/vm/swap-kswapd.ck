@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-kswapd) begin
+(swap-kswapd) write 16 MB
+(swap-kswapd) pass 0: data is consistent
+(swap-kswapd) pass 1: data is consistent
+(swap-kswapd) pass 2: data is consistent
+(swap-kswapd) last writes are intact
+(swap-kswapd) end
+EOF
+
+# The test is only worth anything if kswapd did write pages out while
+# others were being swapped back in.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($reclaim) = grep (/^Reclaim: /, @output);
+fail "missing \"Reclaim\" statistics line\n" if !defined $reclaim;
+my ($frames) = $reclaim =~ /^Reclaim: kswapd woke \d+ times, (\d+) frames/;
+fail "kswapd reclaimed no frames\n" if !defined $frames || $frames == 0;
+my ($swap) = grep (/^Swap: /, @output);
+fail "missing \"Swap\" statistics line\n" if !defined $swap;
+my ($in) = $swap =~ / (\d+) in, \d+ shared$/;
+fail "no pages were swapped in\n" if !defined $in || $in == 0;
+pass;
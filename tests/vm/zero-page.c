@@ -0,0 +1,76 @@
+/* Reads untouched bss pages, which get the shared zero page, then
+   writes to some of them.  The written pages must hold what was
+   written and the others must still read as zeros.  A forked child
+   then writes to a page that is still the zero page in both
+   processes, which must leave the parent's copy zero. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT 64
+
+static char pages[PAGE_COUNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+/* Checks that page I is all zeros. */
+static void
+check_zero (size_t i)
+{
+  const char *page = pages + i * PAGE_SIZE;
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    if (page[ofs] != 0)
+      fail ("byte %zu of page %zu has value %02hhx (should be 0)",
+            ofs, i, page[ofs]);
+}
+
+/* Checks that page I is filled with the byte written to it. */
+static void
+check_written (size_t i)
+{
+  const char *page = pages + i * PAGE_SIZE;
+  size_t ofs;
+
+  for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+    if (page[ofs] != (char) ('a' + i))
+      fail ("byte %zu of page %zu has value %02hhx (should be %02hhx)",
+            ofs, i, page[ofs], (char) ('a' + i));
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i, ofs;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    check_zero (i);
+  msg ("read %d untouched pages", PAGE_COUNT);
+
+  for (i = 0; i < PAGE_COUNT; i += 2)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      pages[i * PAGE_SIZE + ofs] = 'a' + i;
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (i % 2 == 0)
+      check_written (i);
+    else
+      check_zero (i);
+  msg ("written pages changed, others still zero");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+        pages[PAGE_SIZE + ofs] = 'a' + 1;
+      check_written (1);
+      check_written (0);
+      msg ("child wrote to a zero page");
+      return;
+    }
+  wait (child);
+  check_zero (1);
+  check_written (0);
+  msg ("parent's zero page is still zero");
+}
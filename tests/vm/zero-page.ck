@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-page) begin
+(zero-page) read 64 untouched pages
+(zero-page) written pages changed, others still zero
+(zero-page) child wrote to a zero page
+(zero-page) end
+(zero-page) parent's zero page is still zero
+(zero-page) end
+EOF
+
+# The reads must have been served by the zero page, and the writes
+# must have replaced it.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($zero) = grep (/^Zero page: /, @output);
+fail "missing \"Zero page\" statistics line\n" if !defined $zero;
+my ($read, $written) = $zero =~ /^Zero page: (\d+) read faults, (\d+) written$/;
+fail "no read faults mapped the zero page\n" if !defined $read || $read < 64;
+fail "only $written writes replaced the zero page\n" if $written < 32;
+pass;
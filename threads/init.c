@@ -17,10 +17,12 @@
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,6 +33,8 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/ksm.h"
+#include "vm/text.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -84,8 +88,10 @@ main (void) {
 
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
+	memtrack_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	vmalloc_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -150,17 +156,36 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = (uint64_t) &start;
+	uint64_t text_end = (uint64_t) &_end_kernel_text;
+
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	// Every aligned 2 MiB stretch that lies entirely inside or
+	// entirely outside the read-only kernel text gets a single
+	// huge page; the rest is mapped with 4 kB pages.
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		if ((pa & HPGMASK) == 0 && pa + HPGSIZE <= mem_end
+				&& (va + HPGSIZE <= text_start || text_end <= va
+					|| (text_start <= va && va + HPGSIZE <= text_end))) {
+			perm = PTE_P | PTE_W | PTE_PS;
+			if (text_start <= va && va < text_end)
+				perm &= ~PTE_W;
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | perm;
+			pa += HPGSIZE;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		if (text_start <= va && va < text_end)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
@@ -226,6 +251,28 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-hugepages"))
+			vm_huge_pages = true;
+		else if (!strcmp (name, "-spt-hash"))
+			vm_spt_hash = true;
+		else if (!strcmp (name, "-kswapd-low"))
+			vm_reclaim_low = atoi (value);
+		else if (!strcmp (name, "-kswapd-high"))
+			vm_reclaim_high = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			vm_zswap_pages = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			vm_ksm_budget = atoi (value);
+		else if (!strcmp (name, "-fault-around"))
+			vm_fault_around = atoi (value);
+		else if (!strcmp (name, "-share-text"))
+			vm_share_text = true;
+		else if (!strcmp (name, "-mlock-limit"))
+			vm_mlock_limit = atoi (value);
+		else if (!strcmp (name, "-mlock-max"))
+			vm_mlock_max = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -328,6 +375,18 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -hugepages         Back large anonymous regions with 2 MiB pages.\n"
+			"  -spt-hash          Keep supplemental page tables in hash tables.\n"
+			"  -kswapd-low=COUNT  Reclaim in the background below COUNT free pages.\n"
+			"  -kswapd-high=COUNT Reclaim in the background up to COUNT free pages.\n"
+			"  -zswap=COUNT       Compress up to COUNT pages' worth of swap in memory.\n"
+			"  -ksm=PERCENT       Merge identical pages, using up to PERCENT of the CPU.\n"
+			"  -fault-around=COUNT Map file pages in windows of COUNT on a fault.\n"
+			"  -share-text        Share read-only executable pages between processes.\n"
+			"  -mlock-limit=COUNT Let each process mlock() up to COUNT pages.\n"
+			"  -mlock-max=COUNT   Let processes mlock() up to COUNT pages in all.\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +413,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	vmalloc_print_stats ();
+	memtrack_report ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +424,7 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
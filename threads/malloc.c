@@ -5,9 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -26,22 +28,33 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator.  A few such
+   empty arenas are kept per descriptor instead, to save a trip
+   through the page allocator when the next arena is needed; a
+   shrinker hands them back when the kernel pool runs low.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   kernel pool is too fragmented to supply the pages physically
+   contiguous, a big block falls back to vmalloc(), which only
+   needs them to be virtually contiguous. */
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
+	struct list empty_list;     /* Cached empty arenas, by first block. */
+	size_t empty_cnt;           /* Number of cached empty arenas. */
 	struct lock lock;           /* Lock. */
 };
 
+/* Maximum number of empty arenas cached per descriptor. */
+#define MAX_EMPTY_ARENAS 4
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -64,6 +77,18 @@ static size_t desc_cnt;         /* Number of descriptors. */
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
+static void *do_malloc (size_t size);
+static size_t arena_count (void);
+static size_t arena_scan (size_t nr_to_scan);
+
+/* Gives cached empty arenas back to the page allocator. */
+static struct shrinker arena_shrinker = {
+	.name = "malloc-arenas",
+	.priority = SHRINK_PRI_ARENAS,
+	.count = arena_count,
+	.scan = arena_scan,
+};
+
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
@@ -75,14 +100,26 @@ malloc_init (void) {
 		d->block_size = block_size;
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
+		list_init (&d->empty_list);
+		d->empty_cnt = 0;
 		lock_init (&d->lock);
 	}
+	shrinker_register (&arena_shrinker);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	void *p = do_malloc (size);
+
+	memtrack_alloc (p, size, __builtin_return_address (0), MT_MALLOC);
+	return p;
+}
+
+/* Does the work of malloc(). */
+static void *
+do_malloc (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -101,6 +138,8 @@ malloc (size_t size) {
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
 		a = palloc_get_multiple (0, page_cnt);
+		if (a == NULL && page_cnt > 1)
+			a = vmalloc (0, page_cnt);
 		if (a == NULL)
 			return NULL;
 
@@ -118,11 +157,20 @@ malloc (size_t size) {
 	if (list_empty (&d->free_list)) {
 		size_t i;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
+		/* Reuse a cached arena or allocate a page.  The lock is
+		   dropped around palloc_get_page(), which may call the
+		   shrinkers; if another thread refills the free list in
+		   the meantime, the new arena's blocks simply join it. */
+		if (!list_empty (&d->empty_list)) {
+			a = block_to_arena (list_entry (list_pop_front (&d->empty_list),
+						struct block, free_elem));
+			d->empty_cnt--;
+		} else {
 			lock_release (&d->lock);
-			return NULL;
+			a = palloc_get_page (0);
+			if (a == NULL)
+				return NULL;
+			lock_acquire (&d->lock);
 		}
 
 		/* Initialize arena and add its blocks to the free list. */
@@ -156,9 +204,10 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = do_malloc (size);
 	if (p != NULL)
 		memset (p, 0, size);
+	memtrack_alloc (p, size, __builtin_return_address (0), MT_MALLOC);
 
 	return p;
 }
@@ -185,7 +234,9 @@ realloc (void *old_block, size_t new_size) {
 		free (old_block);
 		return NULL;
 	} else {
-		void *new_block = malloc (new_size);
+		void *new_block = do_malloc (new_size);
+		memtrack_alloc (new_block, new_size, __builtin_return_address (0),
+				MT_MALLOC);
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -205,6 +256,7 @@ free (void *p) {
 		struct arena *a = block_to_arena (b);
 		struct desc *d = a->desc;
 
+		memtrack_free (p);
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
 
@@ -227,18 +279,61 @@ free (void *p) {
 					struct block *b = arena_to_block (a, i);
 					list_remove (&b->free_elem);
 				}
-				palloc_free_page (a);
+				if (d->empty_cnt < MAX_EMPTY_ARENAS) {
+					list_push_front (&d->empty_list,
+							&arena_to_block (a, 0)->free_elem);
+					d->empty_cnt++;
+				} else
+					palloc_free_page (a);
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			if (is_vmalloc_vaddr (a))
+				vfree (a);
+			else
+				palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Returns the number of cached empty arenas.  Unlocked, so only
+   an estimate. */
+static size_t
+arena_count (void) {
+	size_t cnt = 0;
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++)
+		cnt += d->empty_cnt;
+	return cnt;
+}
+
+/* Frees up to NR_TO_SCAN cached empty arenas, skipping
+   descriptors that are busy, and returns the number freed. */
+static size_t
+arena_scan (size_t nr_to_scan) {
+	size_t freed = 0;
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt && freed < nr_to_scan; d++) {
+		if (lock_held_by_current_thread (&d->lock)
+				|| !lock_try_acquire (&d->lock))
+			continue;
+		while (d->empty_cnt > 0 && freed < nr_to_scan) {
+			struct block *b = list_entry (list_pop_front (&d->empty_list),
+					struct block, free_elem);
+			d->empty_cnt--;
+			palloc_free_page (block_to_arena (b));
+			freed++;
+		}
+		lock_release (&d->lock);
+	}
+	return freed;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
@@ -0,0 +1,213 @@
+#include "threads/memtrack.h"
+#ifdef MEMTRACK
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Allocation tracking.
+
+   Live allocations are kept in a fixed-size, open-addressed hash
+   table keyed by address, with linear probing and backward-shift
+   deletion so that no tombstones build up.  The table is taken
+   from the kernel pool once, at boot, so recording an allocation
+   never allocates memory itself.  palloc_free_page() is called
+   from the scheduler, so the table is only touched with
+   interrupts off. */
+
+/* A live allocation.  Call sites are kernel text addresses, kept
+   as offsets from KERN_BASE. */
+struct mt_entry {
+	void *ptr;                  /* Allocation, null if slot is free. */
+	uint32_t caller;            /* Return address of the request. */
+	uint32_t size;              /* Size in bytes. */
+	tid_t owner;                /* Thread that requested it. */
+	uint16_t kind;              /* enum memtrack_kind. */
+	uint16_t orphaned;          /* Outlived its owner process? */
+};
+
+#define MT_BITS 14
+#define MT_SLOTS (1 << MT_BITS)
+#define MT_PAGES (MT_SLOTS * sizeof (struct mt_entry) / PGSIZE)
+
+static struct mt_entry *table;  /* MT_SLOTS entries. */
+static size_t live_cnt;         /* Number of entries in use. */
+static long long dropped;       /* Allocations not recorded: table full. */
+static long long orphan_cnt;    /* Allocations outliving their process. */
+
+/* Per call-site totals, gathered by memtrack_report(). */
+struct mt_site {
+	uint32_t caller;
+	uint16_t kind;
+	size_t cnt, bytes, orphaned;
+};
+
+#define MT_SITES 64
+static struct mt_site sites[MT_SITES];
+
+static const char *kind_names[] = { "malloc", "palloc" };
+
+/* Returns PTR's home slot. */
+static size_t
+slot_of (const void *ptr) {
+	return ((uint64_t) ptr >> 4) * 0x9e3779b97f4a7c15ULL >> (64 - MT_BITS);
+}
+
+/* Returns the slot holding PTR, or the free slot where it would
+   go.  Interrupts must be off. */
+static size_t
+find_slot (const void *ptr) {
+	size_t i = slot_of (ptr);
+
+	while (table[i].ptr != NULL && table[i].ptr != ptr)
+		i = (i + 1) % MT_SLOTS;
+	return i;
+}
+
+/* Allocates the table.  Allocations made before this are not
+   tracked. */
+void
+memtrack_init (void) {
+	table = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, MT_PAGES);
+}
+
+/* Records that SIZE bytes of KIND were allocated at PTR by a call
+   that returns to CALLER. */
+void
+memtrack_alloc (void *ptr, size_t size, void *caller,
+		enum memtrack_kind kind) {
+	enum intr_level old_level;
+	size_t i;
+
+	if (table == NULL || ptr == NULL)
+		return;
+
+	old_level = intr_disable ();
+	if (live_cnt >= MT_SLOTS - MT_SLOTS / 8)
+		dropped++;
+	else {
+		i = find_slot (ptr);
+		if (table[i].ptr == NULL)
+			live_cnt++;
+		table[i] = (struct mt_entry) {
+			.ptr = ptr,
+			.caller = (uint64_t) caller - KERN_BASE,
+			.size = size,
+			.owner = thread_current ()->tid,
+			.kind = kind,
+		};
+	}
+	intr_set_level (old_level);
+}
+
+/* Forgets the allocation at PTR, if it was recorded. */
+void
+memtrack_free (void *ptr) {
+	enum intr_level old_level;
+	size_t i, j;
+
+	if (table == NULL || ptr == NULL)
+		return;
+
+	old_level = intr_disable ();
+	i = find_slot (ptr);
+	if (table[i].ptr != NULL) {
+		live_cnt--;
+		/* Shift back later entries of the probe run that would no
+		   longer be found past the hole at I. */
+		for (j = (i + 1) % MT_SLOTS; table[j].ptr != NULL;
+				j = (j + 1) % MT_SLOTS) {
+			size_t home = slot_of (table[j].ptr);
+			if ((j - home) % MT_SLOTS >= (j - i) % MT_SLOTS) {
+				table[i] = table[j];
+				i = j;
+			}
+		}
+		table[i].ptr = NULL;
+	}
+	intr_set_level (old_level);
+}
+
+/* Called when process T has released its resources: whatever it
+   allocated that is still live is flagged as orphaned. */
+void
+memtrack_exit (struct thread *t) {
+	enum intr_level old_level;
+	size_t i;
+
+	if (table == NULL)
+		return;
+
+	old_level = intr_disable ();
+	for (i = 0; i < MT_SLOTS; i++)
+		if (table[i].ptr != NULL && table[i].owner == t->tid
+				&& !table[i].orphaned) {
+			table[i].orphaned = true;
+			orphan_cnt++;
+		}
+	intr_set_level (old_level);
+}
+
+/* Adds entry E to the per-site totals, SITE_CNT of which are in
+   use, and returns the new number in use.  Sites beyond MT_SITES
+   are lumped into the last one. */
+static size_t
+add_to_site (const struct mt_entry *e, size_t site_cnt) {
+	struct mt_site *s;
+
+	for (s = sites; s < sites + site_cnt; s++)
+		if (s->caller == e->caller && s->kind == e->kind)
+			break;
+	if (s == sites + site_cnt) {
+		if (site_cnt == MT_SITES)
+			s = &sites[MT_SITES - 1];
+		else {
+			*s = (struct mt_site) { .caller = e->caller, .kind = e->kind };
+			site_cnt++;
+		}
+	}
+	s->cnt++;
+	s->bytes += e->size;
+	s->orphaned += e->orphaned;
+	return site_cnt;
+}
+
+/* Prints live allocations per call site, largest first. */
+void
+memtrack_report (void) {
+	enum intr_level old_level;
+	size_t site_cnt = 0, bytes = 0, i, j;
+
+	if (table == NULL)
+		return;
+
+	old_level = intr_disable ();
+	for (i = 0; i < MT_SLOTS; i++)
+		if (table[i].ptr != NULL) {
+			site_cnt = add_to_site (&table[i], site_cnt);
+			bytes += table[i].size;
+		}
+	intr_set_level (old_level);
+
+	/* Selection sort by live bytes. */
+	for (i = 0; i < site_cnt; i++)
+		for (j = i + 1; j < site_cnt; j++)
+			if (sites[j].bytes > sites[i].bytes) {
+				struct mt_site tmp = sites[i];
+				sites[i] = sites[j];
+				sites[j] = tmp;
+			}
+
+	printf ("Memtrack: %zu live allocations, %zu bytes, "
+			"%lld orphaned, %lld not recorded\n",
+			live_cnt, bytes, orphan_cnt, dropped);
+	for (i = 0; i < site_cnt; i++)
+		printf ("  %#llx %s: %zu live, %zu bytes, %zu orphaned\n",
+				(unsigned long long) KERN_BASE + sites[i].caller,
+				kind_names[sites[i].kind], sites[i].cnt, sites[i].bytes,
+				sites[i].orphaned);
+}
+#endif /* MEMTRACK */
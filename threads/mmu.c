@@ -8,11 +8,41 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Number of 2 MiB mappings split back into 4 kB pages. */
+long long huge_page_splits;
+
+/* Replaces the 2 MiB mapping in *PDE by a page table of 512
+ * 4 kB entries that map the same frames with the same
+ * permissions, so that the pages can then be changed one by one.
+ * The translations do not change, so stale TLB entries for the
+ * huge page stay correct until the caller invalidates them.
+ * Returns false if no page table could be allocated. */
+static bool
+split_huge_pde (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*pde) & ~HPGMASK;
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+
+	if (pt == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	huge_page_splits++;
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		if ((uint64_t) pte & PTE_P && (uint64_t) pte & PTE_PS) {
+			if (!create)
+				return &pdp[idx];
+			if (!split_huge_pde (&pdp[idx]))
+				return NULL;
+		}
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -60,7 +90,10 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR is covered by a 2 MiB page, the page directory entry
+ * that maps it is returned when CREATE is false; when CREATE is
+ * true the huge page is first split into 4 kB pages. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -88,6 +121,29 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page directory entry for virtual
+ * address VADDR in page map level 4, pml4, that is, the entry that
+ * either points to VADDR's page table or maps its 2 MiB page.
+ * Missing page directory pointer tables and page directories are
+ * created if CREATE is true; otherwise a null pointer is returned. */
+uint64_t *
+pml4e_walk_pde (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *table = pml4;
+	int idx[2] = { PML4 (va), PDPE (va) };
+
+	for (int level = 0; level < 2; level++) {
+		uint64_t *entry = &table[idx[level]];
+		if (!(*entry & PTE_P)) {
+			uint64_t *new_page;
+			if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*entry));
+	}
+	return &table[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,7 +178,14 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (((uint64_t) pte) & PTE_P && ((uint64_t) pte) & PTE_PS) {
+			/* A 2 MiB page: hand FUNC the page directory entry. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -143,7 +206,9 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A 2 MiB page is passed to FUNC once, as its page directory
+ * entry. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,7 +234,10 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (((uint64_t) pte) & PTE_P && ((uint64_t) pte) & PTE_PS)
+			palloc_free_multiple ((void *) (PTE_ADDR (pte) & ~HPGMASK),
+					HPG_PAGES);
+		else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -216,6 +284,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
+	if (pte && (*pte & PTE_P) && (*pte & PTE_PS))
+		return ptov (PTE_ADDR (*pte) & ~HPGMASK) + ((uint64_t) uaddr & HPGMASK);
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
@@ -243,17 +313,105 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Maps the 2 MiB of user virtual memory starting at UPAGE in
+ * PML4 to the 512 physically contiguous frames starting at kernel
+ * virtual address KPAGE, with a single page directory entry.
+ * Both addresses must be 2 MiB aligned and KPAGE should come from
+ * palloc_get_huge_page().  No page of the range may be mapped yet.
+ * If WRITABLE is true, the pages are read/write; otherwise they
+ * are read-only.
+ * Returns true if successful, false if memory allocation failed
+ * or part of the range is already mapped. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde;
+	ASSERT (((uint64_t) upage & HPGMASK) == 0);
+	ASSERT ((vtop (kpage) & HPGMASK) == 0);
+	ASSERT (is_user_vaddr ((uint8_t *) upage + HPGSIZE - 1));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pml4e_walk_pde (pml4, (uint64_t) upage, 1);
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		/* A page table whose entries are all gone can be dropped;
+		 * one that still maps anything means the range is in use. */
+		uint64_t *pt;
+		if (*pde & PTE_PS)
+			return false;
+		pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page (pt);
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	if (rcr3 () == vtop (pml4))
+		invlpg ((uint64_t) upage);
+	return true;
+}
+
+static bool
+write_protect_pte (uint64_t *pte, void *va UNUSED, void *aux UNUSED) {
+	if (is_user_pte (pte))
+		*pte &= ~(uint64_t) PTE_W;
+	return true;
+}
+
+/* Makes every user mapping in PML4 read-only, 4 kB and 2 MiB pages
+ * alike, in a single pass over its page tables.  The accessed and
+ * dirty bits are kept.  If PML4 is active, the TLB is flushed once
+ * at the end instead of page by page. */
+void
+pml4_write_protect (uint64_t *pml4) {
+	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
+	if (((uint64_t) pdpe) & PTE_P)
+		pdp_for_each ((uint64_t *) PTE_ADDR (pdpe), write_protect_pte, NULL, 0);
+	if (rcr3 () == vtop (pml4))
+		lcr3 (vtop (pml4));
+}
+
+/* Returns the 4 kB page table entry for VPAGE in PML4, or a null
+ * pointer if there is none.  A 2 MiB page covering VPAGE is split
+ * first, so that the entry, and its accessed and dirty bits, are
+ * VPAGE's alone; the split entries start with the huge page's bits.
+ * The TLB may still hold the 2 MiB translation, so if PML4 is active
+ * it is flushed.  If the split runs out of memory, returns the
+ * 2 MiB entry and sets *HUGE. */
+static uint64_t *
+pte_walk_split (uint64_t *pml4, const void *vpage, bool *huge) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+
+	*huge = false;
+	if (pte != NULL && (*pte & PTE_P) != 0 && (*pte & PTE_PS) != 0) {
+		uint64_t *split = pml4e_walk (pml4, (uint64_t) vpage, true);
+		if (split == NULL) {
+			*huge = true;
+			return pte;
+		}
+		pte = split;
+		if (rcr3 () == vtop (pml4))
+			lcr3 (vtop (pml4));
+	}
+	return pte;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
+ * If UPAGE is part of a 2 MiB page, that page is split first so
+ * that the rest of it stays mapped.
  * UPAGE need not be mapped. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
+	bool huge;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	pte = pte_walk_split (pml4, upage, &huge);
+	if (huge)
+		PANIC ("pml4_clear_page: out of memory splitting huge page");
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
@@ -265,23 +423,30 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
- * Returns false if PML4 contains no PTE for VPAGE. */
+ * Returns false if PML4 contains no PTE for VPAGE.
+ * A 2 MiB page covering VPAGE is split first, like for the other
+ * accessed and dirty bit functions below, so that VPAGE's bit is not
+ * that of the 511 pages around it.  Should that run out of memory,
+ * the 2 MiB page's bit is reported, which errs towards dirty. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	bool huge;
+	uint64_t *pte = pte_walk_split (pml4, vpage, &huge);
 	return pte != NULL && (*pte & PTE_D) != 0;
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
- * in PML4. */
+ * in PML4.  If a 2 MiB page covering VPAGE cannot be split, a dirty
+ * bit is only ever set on it, never cleared. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
-	if (pte) {
+	bool huge;
+	uint64_t *pte = pte_walk_split (pml4, vpage, &huge);
+	if (pte && !(huge && !dirty)) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
@@ -294,20 +459,23 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
  * PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_accessed (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	bool huge;
+	uint64_t *pte = pte_walk_split (pml4, vpage, &huge);
 	return pte != NULL && (*pte & PTE_A) != 0;
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  If a 2 MiB page covering VPAGE cannot be split, an
+   accessed bit is only ever set on it, never cleared. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
-	if (pte) {
+	bool huge;
+	uint64_t *pte = pte_walk_split (pml4, vpage, &huge);
+	if (pte && !(huge && !accessed)) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
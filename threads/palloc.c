@@ -8,9 +8,13 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/memtrack.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,24 +28,80 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
-
-/* A memory pool. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   That split is only the starting point.  Both pools span all of
+   the memory the allocator manages, and each page belongs to one
+   of them at a time.  When a pool runs short, it borrows a whole
+   2 MiB chunk whose pages are all free from the other pool, as
+   long as the lender is not short itself, the kernel pool stays
+   above a floor, and the user pool stays within -ul.  A chunk
+   does not move back the other way within a second of a move, so
+   the pools do not bounce memory back and forth.
+
+   Kernel subsystems that cache memory they could do without
+   register a "shrinker" (see palloc.h).  Whenever the number of
+   free pages in the kernel pool drops below its low watermark,
+   or an allocation from it fails, the shrinkers are asked in
+   priority order to give memory back until the pool is above its
+   high watermark again.  A failed user allocation also squeezes
+   them if that frees up a chunk to borrow, so caches give memory
+   back before user pages get evicted. */
+
+/* A memory pool.
+   Pages are freed from the scheduler when a dying thread's stack
+   is released, where no lock can be taken, so a pool's bitmap and
+   counters are only touched with interrupts turned off. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct bitmap *used_map;        /* Pages not free in this pool. */
 	uint8_t *base;                  /* Base of pool. */
+
+	size_t page_cnt;                /* Number of pages owned. */
+	size_t free_cnt;                /* Number of free pages. */
+	size_t low_wmark;               /* Shrink when free_cnt drops below. */
+	size_t high_wmark;              /* Shrink until free_cnt reaches. */
+	long long low_cnt;              /* Times free_cnt fell below low_wmark. */
+	long long reclaimed;            /* Pages given back by shrinkers. */
+	long long borrowed;             /* Chunks taken from the other pool. */
+	int64_t failed_tick;            /* Last tick borrowing failed. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Ownership of the pages spanned by the pools, both of which
+   start at the same base.  Pages that cannot be allocated at all
+   (the kernel image, holes in the memory map) are clear in
+   usable_map and marked used in both pools. */
+static struct bitmap *user_map;     /* Pages owned by the user pool. */
+static struct bitmap *usable_map;   /* Pages that can be allocated. */
+
+/* Rebalancing. */
+#define CHUNK_PAGES HPG_PAGES       /* Pages moved at a time. */
+static size_t kernel_floor;         /* Minimum size of kernel pool. */
+static struct pool *last_borrower;  /* Pool that borrowed last... */
+static int64_t last_borrow_tick;    /* ...and when. */
+
+/* Registered shrinkers, in increasing order of priority. */
+static struct list shrinkers;
+
+/* Held while the shrinkers run. */
+static struct lock shrink_lock;
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
-static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
-
-static bool page_from_pool (const struct pool *, void *page);
+static void init_pools (void **bm_base, uint64_t start, uint64_t end);
+static void add_usable (uint64_t start, uint64_t end, uint64_t user_start);
+static struct pool *page_pool (void *page);
+static void init_watermarks (struct pool *);
+static void set_watermarks (struct pool *);
+static size_t take_pages (struct pool *, size_t page_cnt);
+static void *get_multiple (enum palloc_flags, size_t page_cnt);
+static void relieve_pressure (struct pool *, bool failed);
+static void shrink_pool (size_t target);
+static bool borrow_chunk (struct pool *);
+static void move_chunk (struct pool *from, struct pool *to,
+		size_t start, size_t end, size_t cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -133,6 +193,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 	enum { KERN_START, KERN, USER_START, USER } state = KERN_START;
 	uint64_t rem = kern_pages;
 	uint64_t region_start = 0, end = 0, start, size, size_in_pg;
+	uint64_t kern_start = 0;
 
 	struct multiboot_info *mb_info = ptov (MULTIBOOT_INFO);
 	struct e820_entry *entries = ptov (mb_info->mmap_base);
@@ -147,7 +208,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 			size_in_pg = size / PGSIZE;
 
 			if (state == KERN_START) {
-				region_start = start;
+				region_start = kern_start = start;
 				state = KERN;
 			}
 
@@ -157,9 +218,6 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 						rem -= size_in_pg;
 						break;
 					}
-					// generate kernel pool
-					init_pool (&kernel_pool,
-							&free_start, region_start, start + rem * PGSIZE);
 					// Transition to the next state
 					if (rem == size_in_pg) {
 						rem = user_pages;
@@ -187,14 +245,11 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 		}
 	}
 
-	// generate the user pool
-	init_pool(&user_pool, &free_start, region_start, end);
+	// generate the pools; the user pool's pages start at region_start.
+	init_pools (&free_start, kern_start, end);
 
 	// Iterate over the e820_entry. Setup the usable.
 	uint64_t usable_bound = (uint64_t) free_start;
-	struct pool *pool;
-	void *pool_end;
-	size_t page_idx, page_cnt;
 
 	for (i = 0; i < mb_info->mmap_len / sizeof (struct e820_entry); i++) {
 		struct e820_entry *entry = &entries[i];
@@ -211,27 +266,14 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 
 			start = (uint64_t)
 				pg_round_up (start >= usable_bound ? start : usable_bound);
-split:
-			if (page_from_pool (&kernel_pool, (void *) start))
-				pool = &kernel_pool;
-			else if (page_from_pool (&user_pool, (void *) start))
-				pool = &user_pool;
-			else
-				NOT_REACHED ();
-
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
-			page_idx = pg_no (start) - pg_no (pool->base);
-			if ((uint64_t) pool_end < end) {
-				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
-				start = (uint64_t) pool_end;
-				goto split;
-			} else {
-				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
-			}
+			add_usable (start, end, region_start);
 		}
 	}
+
+	init_watermarks (&kernel_pool);
+	init_watermarks (&user_pool);
+	kernel_floor = kernel_pool.page_cnt / 4 > CHUNK_PAGES ?
+		kernel_pool.page_cnt / 4 : CHUNK_PAGES;
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -243,6 +285,9 @@ palloc_init (void) {
 	struct area base_mem = { .size = 0 };
 	struct area ext_mem = { .size = 0 };
 
+	list_init (&shrinkers);
+	lock_init (&shrink_lock);
+
 	resolve_area_info (&base_mem, &ext_mem);
 	printf ("Pintos booting with: \n");
 	printf ("\tbase_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
@@ -261,13 +306,31 @@ palloc_init (void) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
-	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = get_multiple (flags, page_cnt);
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	memtrack_alloc (pages, page_cnt * PGSIZE, __builtin_return_address (0),
+			MT_PALLOC);
+	return pages;
+}
+
+/* Does the work of palloc_get_multiple(). */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_idx = take_pages (pool, page_cnt);
 	void *pages;
 
+	/* Running low: reclaim or borrow memory, then retry a failed
+	   allocation for as long as borrowing brings in more. */
+	if (page_idx == BITMAP_ERROR || pool->free_cnt < pool->low_wmark) {
+		relieve_pressure (pool, page_idx == BITMAP_ERROR);
+		while (page_idx == BITMAP_ERROR) {
+			page_idx = take_pages (pool, page_cnt);
+			if (page_idx == BITMAP_ERROR && !borrow_chunk (pool))
+				break;
+		}
+	}
+
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
 	else
@@ -293,7 +356,48 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_page (enum palloc_flags flags) {
-	return palloc_get_multiple (flags, 1);
+	void *page = get_multiple (flags, 1);
+
+	memtrack_alloc (page, PGSIZE, __builtin_return_address (0), MT_PALLOC);
+	return page;
+}
+
+/* Obtains HPG_PAGES contiguous free pages that start on a 2 MiB
+   physical boundary, so that they can be mapped as one huge page
+   with pml4_set_huge_page().  FLAGS are interpreted as by
+   palloc_get_multiple().  Free the pages with
+   palloc_free_multiple (PAGES, HPG_PAGES), or one by one. */
+void *
+palloc_get_huge_page (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	uint64_t base_pa = vtop (pool->base);
+	size_t pool_pages = bitmap_size (pool->used_map);
+	size_t page_idx = (ROUND_UP (base_pa, HPGSIZE) - base_pa) / PGSIZE;
+	void *pages = NULL;
+	enum intr_level old_level;
+
+	/* Only 2 MiB-aligned candidates need to be looked at. */
+	old_level = intr_disable ();
+	for (; page_idx + HPG_PAGES <= pool_pages; page_idx += HPG_PAGES)
+		if (!bitmap_contains (pool->used_map, page_idx, HPG_PAGES, true)) {
+			bitmap_set_multiple (pool->used_map, page_idx, HPG_PAGES, true);
+			pool->free_cnt -= HPG_PAGES;
+			pages = pool->base + PGSIZE * page_idx;
+			break;
+		}
+	intr_set_level (old_level);
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, HPGSIZE);
+		memtrack_alloc (pages, HPGSIZE, __builtin_return_address (0),
+				MT_PALLOC);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get_huge_page: out of pages");
+	}
+
+	return pages;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -301,25 +405,24 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
 		return;
 
-	if (page_from_pool (&kernel_pool, pages))
-		pool = &kernel_pool;
-	else if (page_from_pool (&user_pool, pages))
-		pool = &user_pool;
-	else
-		NOT_REACHED ();
-
+	memtrack_free (pages);
+	pool = page_pool (pages);
 	page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	old_level = intr_disable ();
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool->free_cnt += page_cnt;
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,31 +431,317 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
+/* Registers SHRINKER, which must stay valid for as long as the
+   kernel runs.  Its statistics are reset. */
+void
+shrinker_register (struct shrinker *shrinker) {
+	struct list_elem *e;
+
+	ASSERT (shrinker->count != NULL && shrinker->scan != NULL);
+
+	shrinker->calls = shrinker->freed = shrinker->pages = 0;
+	lock_acquire (&shrink_lock);
+	for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+			e = list_next (e))
+		if (list_entry (e, struct shrinker, elem)->priority > shrinker->priority)
+			break;
+	list_insert (e, &shrinker->elem);
+	lock_release (&shrink_lock);
+}
+
+/* Returns the number of free pages in the user pool if FLAGS
+   has PAL_USER set, otherwise in the kernel pool.  The count may
+   be out of date as soon as it is returned. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->free_cnt;
+}
+
+/* Prints page allocator statistics, including how much each
+   shrinker reclaimed, in the order in which they are asked. */
+void
+palloc_print_stats (void) {
+	struct list_elem *e;
+
+	printf ("Kernel pool: %zu of %zu pages free, watermarks %zu/%zu, "
+			"%lld low, %lld pages reclaimed, %lld chunks borrowed\n",
+			kernel_pool.free_cnt, kernel_pool.page_cnt,
+			kernel_pool.low_wmark, kernel_pool.high_wmark,
+			kernel_pool.low_cnt, kernel_pool.reclaimed, kernel_pool.borrowed);
+	printf ("User pool: %zu of %zu pages free, watermarks %zu/%zu, "
+			"%lld low, %lld chunks borrowed\n",
+			user_pool.free_cnt, user_pool.page_cnt,
+			user_pool.low_wmark, user_pool.high_wmark,
+			user_pool.low_cnt, user_pool.borrowed);
+	for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+			e = list_next (e)) {
+		struct shrinker *s = list_entry (e, struct shrinker, elem);
+		printf ("Shrinker %s: %lld calls, %lld objects freed, "
+				"%lld pages reclaimed\n",
+				s->name, s->calls, s->freed, s->pages);
+	}
+}
+
+/* Takes PAGE_CNT contiguous free pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if there is no such
+   run. */
+static size_t
+take_pages (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR) {
+		if (pool->free_cnt >= pool->low_wmark
+				&& pool->free_cnt - page_cnt < pool->low_wmark)
+			pool->low_cnt++;
+		pool->free_cnt -= page_cnt;
+	}
+	intr_set_level (old_level);
+	return page_idx;
+}
+
+/* Called when POOL is low on free pages, or an allocation from
+   it has FAILED.  The kernel pool asks the shrinkers for memory
+   first.  Either pool then borrows a chunk from the other if it
+   is still short; when a user allocation failed and nothing could
+   be borrowed, the kernel's caches are squeezed to make a chunk
+   available. */
 static void
-init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+relieve_pressure (struct pool *pool, bool failed) {
+	if (pool == &kernel_pool) {
+		shrink_pool (pool->high_wmark);
+		if (failed || pool->free_cnt < pool->low_wmark)
+			borrow_chunk (pool);
+	} else if (!borrow_chunk (pool) && failed) {
+		shrink_pool (kernel_pool.high_wmark + CHUNK_PAGES);
+		borrow_chunk (pool);
+	}
+}
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
-	p->base = (void *) start;
+/* Asks the shrinkers to give memory back until the kernel pool
+   has at least TARGET free pages.  Does nothing if the shrinkers
+   are already running, either in another thread or further up in
+   this one (a shrinker may itself allocate memory). */
+static void
+shrink_pool (size_t target) {
+	struct pool *pool = &kernel_pool;
+	struct list_elem *e;
+
+	if (lock_held_by_current_thread (&shrink_lock)
+			|| !lock_try_acquire (&shrink_lock))
+		return;
 
-	// Mark all to unusable.
-	bitmap_set_all(p->used_map, true);
+	for (e = list_begin (&shrinkers);
+			e != list_end (&shrinkers) && pool->free_cnt < target;
+			e = list_next (e)) {
+		struct shrinker *s = list_entry (e, struct shrinker, elem);
+		size_t before = pool->free_cnt;
+
+		if (s->count () == 0)
+			continue;
+		s->calls++;
+		s->freed += s->scan (target - before);
+		if (pool->free_cnt > before) {
+			s->pages += pool->free_cnt - before;
+			pool->reclaimed += pool->free_cnt - before;
+		}
+	}
+	lock_release (&shrink_lock);
+}
+
+/* Returns the range of page indices, [*START, *END), that makes
+   up chunk CHUNK.  Chunks are 2 MiB aligned in physical memory,
+   so that borrowed memory can still back huge pages. */
+static void
+chunk_range (size_t chunk, size_t *start, size_t *end) {
+	size_t skew = pg_no (vtop (kernel_pool.base)) % CHUNK_PAGES;
+	size_t pool_pages = bitmap_size (usable_map);
+
+	*start = chunk * CHUNK_PAGES > skew ? chunk * CHUNK_PAGES - skew : 0;
+	*end = (chunk + 1) * CHUNK_PAGES - skew;
+	if (*end > pool_pages)
+		*end = pool_pages;
+}
 
-	*bm_base += bm_pages;
+/* Returns the number of chunks spanned by the pools. */
+static size_t
+chunk_cnt (void) {
+	size_t skew = pg_no (vtop (kernel_pool.base)) % CHUNK_PAGES;
+	return DIV_ROUND_UP (bitmap_size (usable_map) + skew, CHUNK_PAGES);
 }
 
-/* Returns true if PAGE was allocated from POOL,
-   false otherwise. */
+/* Returns the number of pages FROM owns in the chunk spanning
+   page indices [START, END) if all of them are free, 0
+   otherwise. */
+static size_t
+chunk_free_pages (struct pool *from, size_t start, size_t end) {
+	size_t i, cnt = 0;
+
+	for (i = start; i < end; i++) {
+		if (!bitmap_test (usable_map, i)
+				|| bitmap_test (user_map, i) != (from == &user_pool))
+			continue;
+		if (bitmap_test (from->used_map, i))
+			return 0;
+		cnt++;
+	}
+	return cnt;
+}
+
+/* Returns true if FROM can lend PAGE_CNT free pages to TO without
+   going short itself or breaking the kernel floor or -ul. */
+static bool
+may_lend (struct pool *from, struct pool *to, size_t page_cnt) {
+	if (from->free_cnt < page_cnt
+			|| from->free_cnt - page_cnt < from->high_wmark)
+		return false;
+	if (from == &kernel_pool)
+		return from->page_cnt - page_cnt >= kernel_floor
+			&& to->page_cnt + page_cnt <= user_page_limit;
+	return true;
+}
+
+/* Moves one chunk of free pages from the other pool to POOL,
+   taking the highest such chunk, since both pools allocate from
+   the bottom up.  Returns true if successful.
+   Interrupts are turned off for one chunk at a time, while it is
+   checked and, if it qualifies, handed over, rather than for the
+   whole search. */
 static bool
-page_from_pool (const struct pool *pool, void *page) {
+borrow_chunk (struct pool *pool) {
+	struct pool *from = pool == &user_pool ? &kernel_pool : &user_pool;
+	int64_t now = timer_ticks ();
+	enum intr_level old_level;
+	size_t chunk, start, end, cnt = 0;
+
+	/* Hysteresis: no move back right after a move, and no second
+	   search in the same tick after one that failed. */
+	if ((last_borrower == from && now - last_borrow_tick < TIMER_FREQ)
+			|| pool->failed_tick == now)
+		return false;
+
+	for (chunk = chunk_cnt (); cnt == 0 && chunk-- > 0; ) {
+		chunk_range (chunk, &start, &end);
+		old_level = intr_disable ();
+		cnt = chunk_free_pages (from, start, end);
+		if (cnt > 0 && may_lend (from, pool, cnt))
+			move_chunk (from, pool, start, end, cnt);
+		else
+			cnt = 0;
+		intr_set_level (old_level);
+	}
+
+	if (cnt > 0) {
+		pool->borrowed++;
+		last_borrower = pool;
+		last_borrow_tick = now;
+	} else
+		pool->failed_tick = now;
+	return cnt > 0;
+}
+
+/* Hands the CNT pages FROM owns in [START, END), all of them free,
+   over to TO.  Interrupts must be off. */
+static void
+move_chunk (struct pool *from, struct pool *to, size_t start, size_t end,
+		size_t cnt) {
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (i = start; i < end; i++)
+		if (bitmap_test (usable_map, i)
+				&& bitmap_test (user_map, i) == (from == &user_pool)) {
+			bitmap_mark (from->used_map, i);
+			bitmap_reset (to->used_map, i);
+			bitmap_set (user_map, i, to == &user_pool);
+		}
+	from->page_cnt -= cnt;
+	from->free_cnt -= cnt;
+	to->page_cnt += cnt;
+	to->free_cnt += cnt;
+	set_watermarks (from);
+	set_watermarks (to);
+}
+
+/* Counts POOL's pages and sets its watermarks from them. */
+static void
+init_watermarks (struct pool *pool) {
+	size_t i;
+
+	for (i = 0; i < bitmap_size (usable_map); i++)
+		if (bitmap_test (usable_map, i)
+				&& bitmap_test (user_map, i) == (pool == &user_pool)) {
+			pool->page_cnt++;
+			if (!bitmap_test (pool->used_map, i))
+				pool->free_cnt++;
+		}
+	pool->failed_tick = -1;
+	set_watermarks (pool);
+}
+
+/* Sets POOL's watermarks in proportion to its size. */
+static void
+set_watermarks (struct pool *pool) {
+	pool->low_wmark = pool->page_cnt / 64 > 8 ? pool->page_cnt / 64 : 8;
+	pool->high_wmark = pool->low_wmark * 2;
+}
+
+/* Creates a bitmap of PAGE_CNT bits, all set to VALUE, at *BM_BASE
+   and advances *BM_BASE past it. */
+static struct bitmap *
+create_map (void **bm_base, size_t page_cnt, bool value) {
+	size_t size = bitmap_buf_size (page_cnt);
+	struct bitmap *b = bitmap_create_in_buf (page_cnt, *bm_base, size);
+
+	bitmap_set_all (b, value);
+	*bm_base += size;
+	return b;
+}
+
+/* Initializes both pools as spanning START to END, placing their
+   bitmaps at *BM_BASE.  Every page starts out unusable, owned by
+   the kernel pool and used in both pools. */
+static void
+init_pools (void **bm_base, uint64_t start, uint64_t end) {
+	uint64_t pgcnt = (end - start) / PGSIZE;
+
+	kernel_pool.used_map = create_map (bm_base, pgcnt, true);
+	kernel_pool.base = (void *) start;
+	user_pool.used_map = create_map (bm_base, pgcnt, true);
+	user_pool.base = (void *) start;
+	user_map = create_map (bm_base, pgcnt, false);
+	usable_map = create_map (bm_base, pgcnt, false);
+	*bm_base = pg_round_up (*bm_base);
+}
+
+/* Makes the pages from START to END available, to the user pool
+   from USER_START on and to the kernel pool below that. */
+static void
+add_usable (uint64_t start, uint64_t end, uint64_t user_start) {
+	uint64_t base = (uint64_t) kernel_pool.base;
+
+	for (; start < end; start += PGSIZE) {
+		size_t idx = (start - base) / PGSIZE;
+		struct pool *pool = start >= user_start ? &user_pool : &kernel_pool;
+
+		bitmap_mark (usable_map, idx);
+		bitmap_set (user_map, idx, pool == &user_pool);
+		bitmap_reset (pool->used_map, idx);
+	}
+}
+
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+page_pool (void *page) {
 	size_t page_no = pg_no (page);
-	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
-	return page_no >= start_page && page_no < end_page;
+	size_t start_page = pg_no (kernel_pool.base);
+
+	ASSERT (page_no >= start_page
+			&& page_no < start_page + bitmap_size (usable_map));
+	return bitmap_test (user_map, page_no - start_page) ?
+		&user_pool : &kernel_pool;
 }
@@ -0,0 +1,204 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Virtually contiguous kernel allocator.
+
+   palloc_get_multiple() can only satisfy a request for N pages
+   if N physically adjacent pages are free, which stops working
+   once the kernel pool is fragmented.  vmalloc() instead takes N
+   arbitrary pages from the kernel pool and maps them back to back
+   in a dedicated range of kernel virtual addresses
+   (VMALLOC_START...VMALLOC_END).
+
+   The page-table pages covering that range hang off base_pml4's
+   kernel slot, which every user pml4 shares (see pml4_create()),
+   so a mapping is visible in all address spaces as soon as it is
+   installed.  Each allocation is followed by an unmapped guard
+   page, so running off the end of a buffer faults instead of
+   silently corrupting the next one.
+
+   Memory from vmalloc() is only virtually contiguous: vtop() does
+   not work on it, and it must be released with vfree(), not
+   palloc_free_multiple(). */
+
+/* A live vmalloc() allocation. */
+struct vm_area {
+	struct list_elem elem;      /* Element in `areas'. */
+	void *base;                 /* First mapped page. */
+	size_t page_cnt;            /* Mapped pages, excluding the guard. */
+};
+
+static struct lock vmalloc_lock;    /* Protects everything below. */
+static struct bitmap *va_map;       /* Used pages of the vmalloc range. */
+static struct list areas;           /* Live allocations. */
+static bool vmalloc_ready;          /* vmalloc_init() done? */
+
+/* Statistics. */
+static size_t live_pages;           /* Pages currently mapped. */
+static long long alloc_cnt;         /* Successful vmalloc() calls. */
+static long long fail_cnt;          /* Failed vmalloc() calls. */
+
+static void unmap_pages (void *base, size_t page_cnt);
+
+/* Initializes the vmalloc range.  Must be called after
+   paging_init(), once base_pml4 is active. */
+void
+vmalloc_init (void) {
+	ASSERT (base_pml4 != NULL);
+	ASSERT (PML4 (VMALLOC_START) == PML4 (KERN_BASE));
+	ASSERT (PML4 (VMALLOC_END - 1) == PML4 (KERN_BASE));
+
+	lock_init (&vmalloc_lock);
+	list_init (&areas);
+	va_map = bitmap_create (VMALLOC_SIZE / PGSIZE);
+	if (va_map == NULL)
+		PANIC ("vmalloc_init: out of memory");
+	vmalloc_ready = true;
+}
+
+/* Obtains PAGE_CNT pages from the kernel pool, which need not be
+   physically contiguous, maps them at consecutive kernel virtual
+   addresses and returns the first one.  If PAL_ZERO is set in
+   FLAGS, the pages are zeroed.  Returns a null pointer on failure,
+   unless PAL_ASSERT is set, in which case the kernel panics.
+   PAL_USER is not allowed. */
+void *
+vmalloc (enum palloc_flags flags, size_t page_cnt) {
+	struct vm_area *area;
+	size_t idx, i;
+	uint8_t *base;
+
+	ASSERT (!(flags & PAL_USER));
+
+	if (!vmalloc_ready || page_cnt == 0)
+		goto fail;
+	area = malloc (sizeof *area);
+	if (area == NULL)
+		goto fail;
+
+	/* Reserve the virtual range, plus a guard page. */
+	lock_acquire (&vmalloc_lock);
+	idx = bitmap_scan_and_flip (va_map, 0, page_cnt + 1, false);
+	lock_release (&vmalloc_lock);
+	if (idx == BITMAP_ERROR) {
+		free (area);
+		goto fail;
+	}
+	base = (uint8_t *) VMALLOC_START + idx * PGSIZE;
+
+	/* Back it page by page from anywhere in the kernel pool. */
+	for (i = 0; i < page_cnt; i++) {
+		void *kpage = palloc_get_page (flags & PAL_ZERO);
+		uint64_t *pte = NULL;
+
+		if (kpage != NULL) {
+			lock_acquire (&vmalloc_lock);
+			pte = pml4e_walk (base_pml4, (uint64_t) base + i * PGSIZE, 1);
+			if (pte != NULL)
+				*pte = vtop (kpage) | PTE_P | PTE_W;
+			lock_release (&vmalloc_lock);
+		}
+		if (pte == NULL) {
+			palloc_free_page (kpage);
+			unmap_pages (base, i);
+			lock_acquire (&vmalloc_lock);
+			bitmap_set_multiple (va_map, idx, page_cnt + 1, false);
+			lock_release (&vmalloc_lock);
+			free (area);
+			goto fail;
+		}
+	}
+
+	area->base = base;
+	area->page_cnt = page_cnt;
+	lock_acquire (&vmalloc_lock);
+	list_push_back (&areas, &area->elem);
+	live_pages += page_cnt;
+	alloc_cnt++;
+	lock_release (&vmalloc_lock);
+	return base;
+
+fail:
+	if (flags & PAL_ASSERT)
+		PANIC ("vmalloc: out of memory");
+	if (vmalloc_ready) {
+		lock_acquire (&vmalloc_lock);
+		fail_cnt++;
+		lock_release (&vmalloc_lock);
+	}
+	return NULL;
+}
+
+/* Frees the pages at PAGES, which must have been returned by
+   vmalloc(). */
+void
+vfree (void *pages) {
+	struct vm_area *area = NULL;
+	struct list_elem *e;
+	size_t idx;
+
+	if (pages == NULL)
+		return;
+	ASSERT (is_vmalloc_vaddr (pages));
+	ASSERT (pg_ofs (pages) == 0);
+
+	lock_acquire (&vmalloc_lock);
+	for (e = list_begin (&areas); e != list_end (&areas); e = list_next (e))
+		if (list_entry (e, struct vm_area, elem)->base == pages) {
+			area = list_entry (e, struct vm_area, elem);
+			list_remove (e);
+			live_pages -= area->page_cnt;
+			break;
+		}
+	lock_release (&vmalloc_lock);
+	ASSERT (area != NULL);
+
+	unmap_pages (area->base, area->page_cnt);
+
+	idx = ((uint64_t) area->base - VMALLOC_START) / PGSIZE;
+	lock_acquire (&vmalloc_lock);
+	bitmap_set_multiple (va_map, idx, area->page_cnt + 1, false);
+	lock_release (&vmalloc_lock);
+	free (area);
+}
+
+/* Prints vmalloc statistics. */
+void
+vmalloc_print_stats (void) {
+	printf ("vmalloc: %lld allocations, %lld failures, %zu pages mapped\n",
+			alloc_cnt, fail_cnt, live_pages);
+}
+
+/* Unmaps the PAGE_CNT pages mapped at BASE and returns their
+   frames to the kernel pool. */
+static void
+unmap_pages (void *base, size_t page_cnt) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		uint64_t va = (uint64_t) base + i * PGSIZE;
+		uint64_t *pte;
+		void *kpage;
+
+		lock_acquire (&vmalloc_lock);
+		pte = pml4e_walk (base_pml4, va, 0);
+		ASSERT (pte != NULL && (*pte & PTE_P));
+		kpage = ptov (PTE_ADDR (*pte));
+		*pte = 0;
+		invlpg (va);
+		lock_release (&vmalloc_lock);
+
+		palloc_free_page (kpage);
+	}
+}
@@ -24,6 +24,7 @@
 
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "userprog/syscall.h"
 #include "filesys/inode.h"
 
@@ -348,6 +349,7 @@ process_exec (void *f_name) {
 #ifdef VM
 	/* Init SPT.*/
 	supplemental_page_table_init(&thread_current()->spt);
+	vm_exec_begin();
 #endif
 #ifdef EFILESYS
 	thread_current()->current_dir = dir_open_root();
@@ -454,6 +456,7 @@ process_exit (void) {
 	/* ENDOFNEWCODE */
 
 	process_cleanup ();
+	memtrack_exit (current);
 }
 
 /* Free the current process's resources. */
@@ -897,9 +900,8 @@ lazy_load_segment (struct page *page, void *aux) {
 	struct file* file = ((struct lazy_aux*)aux)->executable;
 	if (kpage == NULL)
 		return false;
-	// Load this page.
-	file_seek(file, ofs);
-	if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
+	// Load this page. The file may be shared with forked children : no seeking.
+	if (file_read_at (file, kpage, page_read_bytes, ofs) != (int) page_read_bytes) {
 		//printf("load failed..\n");
 		return false;
 	}
@@ -942,6 +944,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		AUX->page_read_bytes = page_read_bytes;
 		AUX->page_zero_bytes = page_zero_bytes;
 		AUX->offset = ofs;
+		AUX->ref_cnt = 1;
+		AUX->own_file = false;	//The process's executable, closed at exit.
 		aux = AUX;
 		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
 					writable, lazy_load_segment, aux)){
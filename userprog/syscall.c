@@ -327,23 +327,54 @@ tid_t fork (const char *thread_name, struct intr_frame* if_){
 
 #ifdef VM
 //mmap : Maps "length" bytes of the file "fd" starting from "offset", into VA space at "addr".
+//"writable" may include MAP_ANONYMOUS, for zero-filled memory with "fd" -1, and MAP_POPULATE, to load the pages now.
 void* mmap (void *addr, size_t length, int writable, int fd, off_t offset){
-	//2. Get the file "FD".
-	struct file* FILE;
-	lock_acquire(&filesys_lock);
-	FILE = process_get_file(fd);
-	if(FILE == NULL){
+	int flags = writable & (MAP_ANONYMOUS | MAP_POPULATE);
+	void* result;
+	writable &= ~flags;
+	if(flags & MAP_ANONYMOUS){
+		if(fd != -1 || offset != 0){
+			return NULL;
+		}
+		result = do_mmap_anon(addr, length, writable);
+	}
+	else{
+		//2. Get the file "FD".
+		struct file* FILE;
+		lock_acquire(&filesys_lock);
+		FILE = process_get_file(fd);
+		if(FILE == NULL){
+			lock_release(&filesys_lock);
+			return NULL;
+		}
 		lock_release(&filesys_lock);
-		return NULL;
+		result = do_mmap (addr, length, writable, FILE, offset);
 	}
-	lock_release(&filesys_lock);
-	return do_mmap (addr, length, writable, FILE, offset);
+	if(result != NULL && (flags & MAP_POPULATE)){
+		vm_populate(result, length);
+	}
+	return result;
 }
 
 //munmap : Unmaps the mapping for the address range "addr".
 void munmap (void *addr){
 	return do_munmap(addr);
 }
+
+//madvise : Advises the VM on the use of "length" bytes at "addr". 0 on success, -1 on error.
+static int madvise (void *addr, size_t length, int advice){
+	return vm_madvise(addr, length, advice);
+}
+
+//mlock : Loads the pages of "length" bytes at "addr", and keeps them in memory. 0 on success, -1 on error.
+static int mlock (const void *addr, size_t length){
+	return vm_mlock(addr, length);
+}
+
+//munlock : Lets the pages of "length" bytes at "addr" be evicted again. 0 on success, -1 on error.
+static int munlock (const void *addr, size_t length){
+	return vm_munlock(addr, length);
+}
 #endif
 
 #ifdef EFILESYS
@@ -417,6 +448,9 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	check_address((void*)f->rsp);
 #ifdef VM
 	current->syscall_rsp = f->rsp;
+	if(current->exec_tsc != 0){	//First system call since exec : it has reached main().
+		vm_exec_end();
+	}
 #endif
 	//get the system call number from "rax".
 	syscall_num = (int) f->R.rax;
@@ -608,6 +642,40 @@ syscall_handler (struct intr_frame *f UNUSED) {
 			munmap(addr);
 			break;
 		}/* Remove mapping of file-mapped pages. */
+		case SYS_MADVISE:
+		{
+			//3 arguments. addr, length, advice.
+			void* addr = (void*) f->R.rdi;
+			size_t length = (size_t) f->R.rsi;
+			int advice = (int) f->R.rdx;
+			int result;
+
+			result = madvise(addr, length, advice);
+			f->R.rax = (uint64_t) result;
+			break;
+		}/* Advise on the use of memory. */
+		case SYS_MLOCK:
+		{
+			//2 arguments. addr, length.
+			void* addr = (void*) f->R.rdi;
+			size_t length = (size_t) f->R.rsi;
+			int result;
+
+			result = mlock(addr, length);
+			f->R.rax = (uint64_t) result;
+			break;
+		}/* Lock pages in memory. */
+		case SYS_MUNLOCK:
+		{
+			//2 arguments. addr, length.
+			void* addr = (void*) f->R.rdi;
+			size_t length = (size_t) f->R.rsi;
+			int result;
+
+			result = munlock(addr, length);
+			f->R.rax = (uint64_t) result;
+			break;
+		}/* Unlock pages. */
 #endif
 #ifdef EFILESYS
 		case SYS_CHDIR:
@@ -1,9 +1,18 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/disk.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "vm/ksm.h"
+#include "vm/text.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -19,23 +28,89 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
-static struct list swap_list;	//swap table.
+static struct bitmap *swap_map;	//swap table : one bit per slot, true if in use.
 static struct lock swap_lock;	//swap lock -> use this when modifying swap slots.
-static int nSlots;		//MAX #. of slots, index goes up to 0 ~ (nSlots - 1).
+static size_t nSlots;		//MAX #. of slots, index goes up to 0 ~ (nSlots - 1).
+static size_t swap_hint;	//where the next search for a free slot starts.
+static uint16_t *slot_share;	//pages sharing each slot besides the first, since a fork or a shared eviction.
 static void swap_init(void);
+static size_t swap_write_batch(struct page *pages[], size_t cnt);
+
+/* Swap cache : pages read ahead on a swap-in, oldest first. A cached page keeps
+ * its swap slot, so dropping the copy costs nothing but the read. */
+static struct list swap_cache;
+static size_t swap_cache_cnt;	//pages in the swap cache.
+static size_t ra_window = 1;	//pages to read ahead on the next swap-in.
+static size_t ra_last_slot = NO_SLOT;	//slot of the last page swapped in from disk.
+
+/* Compressed swap tier (zswap) : with -zswap, evicted pages are compressed into
+ * a pool of kernel memory and only go to the swap disk, oldest first, when the
+ * pool is full. Pages that are all zeros are only flagged, and pages that do not
+ * compress to half a page or less go straight to disk. */
+size_t vm_zswap_pages;
+
+#define ZSWAP_MAX_SIZE (PGSIZE / 2 - sizeof(struct zswap_entry))	//so an entry is one malloc block.
+
+struct zswap_entry {
+	struct page* page;		//Page whose contents these are.
+	struct list_elem elem;		//Element in zswap_lru.
+	size_t size;			//Bytes of compressed data.
+	uint8_t data[];			//Compressed contents.
+};
+
+static struct lock zswap_lock;		//zswap lock -> protects the pool, the buffers and anon_page->zswap.
+static struct list zswap_lru;		//entries, least recently stored first.
+static size_t zswap_cnt;		//pages in the pool.
+static size_t zswap_bytes;		//bytes the pool takes up.
+static uint8_t zswap_buf[ZSWAP_MAX_SIZE];	//compression output.
+static uint8_t zswap_work[LZ_WORK_SIZE];	//compressor scratch space.
+static void* zswap_page;		//decompression output for writeback.
+static bool zswap_store(struct page* page);
+static bool zswap_load(struct page* page, void* kva);
+static void zswap_drop(struct page* page);
+
+/* Statistics. */
+static size_t swap_used;		//slots in use.
+static size_t swap_high;		//most slots ever in use at once.
+static long long swap_out_cnt;		//pages written to swap.
+static long long swap_in_cnt;		//pages read back from swap.
+static long long swap_batch_cnt;	//disk transfers that swapped pages out.
+static long long slot_share_cnt;	//pages given a slot another page holds.
+static long long zswap_fork_cnt;	//compressed pages copied for forked children.
+static long long ra_cnt;		//pages read ahead.
+static long long ra_hit_cnt;		//read-ahead pages that were faulted in.
+static long long ra_waste_cnt;		//read-ahead pages dropped unused.
+static long long zswap_store_cnt;	//pages compressed into the pool.
+static long long zswap_orig_bytes;	//their size...
+static long long zswap_comp_bytes;	//...and their compressed size.
+static long long zswap_zero_cnt;	//zero-filled pages swapped out as a flag.
+static long long zswap_reject_cnt;	//pages that did not compress well enough.
+static long long zswap_hit_cnt;		//pages swapped back in from the pool.
+static long long zswap_zero_hit_cnt;	//zero-filled pages swapped back in.
+static long long zswap_writeback_cnt;	//pages written from the pool to the swap disk.
 
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get (1,1);	//1:1 - swap
-	list_init(&swap_list);
 	lock_init(&swap_lock);
+	list_init(&swap_cache);
+	lock_init(&zswap_lock);
+	list_init(&zswap_lru);
 	swap_init();
+	if(vm_zswap_pages > 0){
+		zswap_page = palloc_get_page(PAL_ASSERT);
+	}
 }
 
 static void swap_init(void){
-	nSlots = ((int) disk_size(swap_disk)) / SECTORS_PER_PAGE;
+	nSlots = swap_disk != NULL ? disk_size(swap_disk) / SECTORS_PER_PAGE : 0;
+	swap_map = bitmap_create(nSlots);
+	slot_share = calloc(nSlots, sizeof *slot_share);
+	if(swap_map == NULL || (nSlots > 0 && slot_share == NULL)){
+		PANIC("swap table creation failed--swap disk is too big");
+	}
 	//printf("nSlots : %d\n",nSlots);
 }
 
@@ -49,93 +124,527 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	anon_page->init = page->uninit.init;
 	anon_page->aux = page->uninit.aux;
 	anon_page->type = page->uninit.type;
-	anon_page->slot = NULL;
+	anon_page->slot = NO_SLOT;
+	anon_page->cache = NULL;
+	anon_page->zswap = NULL;
+	anon_page->zero = false;
+	anon_page->ksm = NULL;
+	anon_page->text = NULL;
+	return true;
 }
 
-/* Get an available swap slot. allocate a NEW one. */
-static struct swap_slot* get_available_slot(void){
-	struct list_elem* e;
-	struct swap_slot* target = NULL;
+/* Get CNT consecutive available swap slots and return the first, or NO_SLOT if
+ * there is no such run. The search starts where the last one left off, so slots
+ * are handed out round-robin. */
+static size_t get_available_slots(size_t cnt){
+	size_t slot;
 	lock_acquire(&swap_lock);
-	for(e = list_begin(&swap_list); e != list_end(&swap_list); e = list_next(e)){
-		struct swap_slot* slot = list_entry(e, struct swap_slot, elem);
-		if(slot->free){	//This slot is FREE. choose this.
-			slot->free = false;
-			target = slot;
-			break;
-		}
+	slot = bitmap_scan_and_flip(swap_map, swap_hint, cnt, false);
+	if(slot == BITMAP_ERROR && swap_hint != 0){	//Wrap around.
+		slot = bitmap_scan_and_flip(swap_map, 0, cnt, false);
 	}
-	if(target == NULL){	//None of the slots were available, allocate a NEW one.
-		int size = (int) list_size(&swap_list);
-		if(size > nSlots){
-			lock_release(&swap_lock);
-			return NULL;
+	if(slot != BITMAP_ERROR){
+		swap_hint = slot + cnt < nSlots ? slot + cnt : 0;
+		swap_used += cnt;
+		if(swap_used > swap_high){
+			swap_high = swap_used;
 		}
-		target = malloc(sizeof(struct swap_slot));
-		ASSERT(target != NULL);
-		target->free = false;
-		target->slotNo = size;
-		list_push_back(&swap_list, &target->elem);
-		//printf("Added new swap-slot No.%d\n", target->slotNo);
+	}
+	else{
+		slot = NO_SLOT;
 	}
 	lock_release(&swap_lock);
-	return target;
+	return slot;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Give SLOT back to the swap table, unless other pages still share it. */
+static void free_slot(size_t slot){
+	lock_acquire(&swap_lock);
+	ASSERT(bitmap_test(swap_map, slot));
+	if(slot_share[slot] > 0){
+		slot_share[slot]--;
+	}
+	else{
+		bitmap_reset(swap_map, slot);
+		swap_used--;
+	}
+	lock_release(&swap_lock);
+}
+
+/* Have one more page share SLOT. Called with swap_lock held. */
+static void share_slot(size_t slot){
+	ASSERT(bitmap_test(swap_map, slot));
+	slot_share[slot]++;
+	slot_share_cnt++;
+}
+
+/* Swap in the page by read contents from the swap disk.
+ * The following pages of the same process that went to the following slots,
+ * typically because they were swapped out together, are read in the same
+ * request into the swap cache, up to ra_window of them. The window grows with
+ * each read-ahead page that is faulted in, halves with each one dropped unused,
+ * and is reopened by two swap-ins from consecutive slots. Pages advised
+ * MADV_RANDOM or MADV_SEQUENTIAL use no window or the largest one instead. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
-	int i;
-	struct swap_slot* slot = anon_page->slot;	//get the slot.
-	if(slot == NULL){				//This page wasn't swapped out. Finish here.
+	struct disk_iovec iov[1 + SWAP_READAHEAD];
+	struct page* ahead[SWAP_READAHEAD];
+	size_t window, cnt, i, slot;
+	if(anon_page->zero){				//Zero-filled : nothing was stored.
+		memset(kva, 0, PGSIZE);
+		anon_page->zero = false;
+		zswap_zero_hit_cnt++;
+		return true;
+	}
+	if(zswap_load(page, kva)){			//Compressed in memory : no I/O.
+		return true;
+	}
+	slot = anon_page->slot;				//get the slot. Final now : the page is not in zswap.
+	if(anon_page->cache != NULL){			//Read ahead : no I/O.
+		void* cache = anon_swap_cache_take(page);
+		memcpy(kva, cache, PGSIZE);
+		palloc_free_page(cache);
+		return true;
+	}
+	if(slot == NO_SLOT){				//This page wasn't swapped out. Finish here.
 		return true;
 	}
-	disk_sector_t sec_no = slot->slotNo * SECTORS_PER_PAGE;		//set sector Number : slotNo * 8
-	//printf("Swapping in ANON-PAGE 0x%X from swap slot %d <-> sector %d\n", page->va, slot->slotNo, sec_no);
-	void* buffer = page->frame->kva;
-	for(i = 0; i < SECTORS_PER_PAGE; i++){	//USE : void disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
-		disk_read(swap_disk, sec_no, buffer);
-		buffer += DISK_SECTOR_SIZE;
-		sec_no++;
+	lock_acquire(&swap_lock);
+	if(ra_window == 0 && slot == ra_last_slot + 1){	//Sequential again.
+		ra_window = 1;
+	}
+	ra_last_slot = slot;
+	window = ra_window;
+	lock_release(&swap_lock);
+	if(page->advice == MADV_RANDOM){		//madvise() : no read-ahead, or all of it.
+		window = 0;
+	}
+	else if(page->advice == MADV_SEQUENTIAL){
+		window = SWAP_READAHEAD;
+	}
+	for(cnt = 0; cnt < window; cnt++){
+		struct page* p = spt_find_page(&thread_current()->spt, page->va + (cnt + 1) * PGSIZE);
+		void* buffer;
+		if(p == NULL || VM_TYPE(p->operations->type) != VM_ANON || p->frame != NULL
+				|| p->anon.slot != slot + cnt + 1 || p->anon.cache != NULL){
+			break;
+		}
+		buffer = palloc_get_page(PAL_USER);	//Only spare memory : never evict for a guess.
+		if(buffer == NULL){
+			break;
+		}
+		ahead[cnt] = p;
+		iov[cnt + 1].buffer = buffer;
+		iov[cnt + 1].sector_cnt = SECTORS_PER_PAGE;
 	}
-	slot->free = true;				//set this slot FREE.
-	anon_page->slot = NULL;				//This page is no longer linked to a swap-slot.
+	disk_sector_t sec_no = slot * SECTORS_PER_PAGE;		//set sector Number : slot * 8
+	//printf("Swapping in ANON-PAGE 0x%X from swap slot %d <-> sector %d\n", page->va, slot, sec_no);
+	iov[0].buffer = kva;
+	iov[0].sector_cnt = SECTORS_PER_PAGE;
+	disk_readv(swap_disk, sec_no, iov, cnt + 1);	//The page and its read-ahead in one request.
+	lock_acquire(&swap_lock);
+	for(i = 0; i < cnt; i++){
+		ahead[i]->anon.cache = iov[i + 1].buffer;
+		list_push_back(&swap_cache, &ahead[i]->anon.cache_elem);
+	}
+	swap_cache_cnt += cnt;
+	ra_cnt += cnt;
+	lock_release(&swap_lock);
+	free_slot(slot);				//set this slot FREE.
+	anon_page->slot = NO_SLOT;			//This page is no longer linked to a swap-slot.
+	swap_in_cnt++;
+	return true;
+}
+
+/* If PAGE was read ahead into the swap cache, take the cached copy out of the
+ * cache, release PAGE's swap slot and return the copy, a user pool page that
+ * now belongs to the caller. Otherwise return NULL. */
+void *
+anon_swap_cache_take (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+	void* cache;
+	lock_acquire(&swap_lock);
+	cache = anon_page->cache;
+	if(cache != NULL){
+		list_remove(&anon_page->cache_elem);
+		anon_page->cache = NULL;
+		swap_cache_cnt--;
+		ra_hit_cnt++;
+		if(ra_window < SWAP_READAHEAD){
+			ra_window++;
+		}
+	}
+	lock_release(&swap_lock);
+	if(cache != NULL){
+		free_slot(anon_page->slot);
+		anon_page->slot = NO_SLOT;
+		swap_in_cnt++;
+	}
+	return cache;
+}
+
+/* Drop the read-ahead copy of ANON_PAGE, which must be in the swap cache.
+ * Called with swap_lock held; returns the copy for the caller to free. */
+static void *
+swap_cache_drop (struct anon_page *anon_page) {
+	void* cache = anon_page->cache;
+	list_remove(&anon_page->cache_elem);
+	anon_page->cache = NULL;
+	swap_cache_cnt--;
+	ra_waste_cnt++;
+	ra_window /= 2;
+	return cache;
+}
+
+/* Give the oldest page in the swap cache back to the user pool. Its contents
+ * are still in its swap slot. Returns false if the cache was empty. */
+bool
+anon_swap_cache_shrink (void) {
+	void* cache = NULL;
+	lock_acquire(&swap_lock);
+	if(!list_empty(&swap_cache)){
+		cache = swap_cache_drop(list_entry(list_front(&swap_cache), struct anon_page, cache_elem));
+	}
+	lock_release(&swap_lock);
+	if(cache == NULL){
+		return false;
+	}
+	palloc_free_page(cache);
 	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
-	int i;
-	struct swap_slot* slot = get_available_slot();			//get a swap slot;
-	if(slot == NULL){
-		//printf("ANON-PAGE 0x%X Failed to get a swap-slot!!\n", page->va);
-		return false;
+	return anon_swap_out_batch(&page, 1) == 1;
+}
+
+/* Swap out the CNT anonymous pages in PAGES, which must all be in frames.
+ * With zswap, pages go to the pool for as long as they compress. The rest go to
+ * a run of consecutive swap slots with a single disk transfer; if there is no run
+ * of that many free slots, only the first half, quarter and so on go. Returns
+ * the number of pages swapped out, always the first ones in PAGES; 0 means the
+ * swap disk is full. */
+size_t
+anon_swap_out_batch (struct page *pages[], size_t cnt) {
+	size_t done = 0;
+	ASSERT(cnt > 0 && cnt <= SWAP_BATCH);
+	if(vm_zswap_pages > 0){
+		for(; done < cnt && zswap_store(pages[done]); done++){
+			pages[done]->frame = NULL;
+		}
+		if(done == cnt){
+			return cnt;
+		}
+	}
+	return done + swap_write_batch(pages + done, cnt - done);
+}
+
+/* Swap out PAGE, whose frame other pages map too, straight to a swap slot,
+ * for them to share with anon_share_slot(). The zswap pool keeps one page per
+ * entry, so it is left out. Returns false if the swap disk is full. */
+bool
+anon_swap_out_shared (struct page *page) {
+	return swap_write_batch(&page, 1) == 1;
+}
+
+/* Make PAGE, an uninit anonymous page that mapped the frame of FROM copy-on-write
+ * until anon_swap_out_shared() swapped FROM out, an anonymous page in the same
+ * slot. The slot is freed when the last page sharing it lets go. */
+void
+anon_share_slot (struct page *page, struct page *from) {
+	ASSERT(VM_TYPE(page->operations->type) == VM_UNINIT);
+	page->uninit.page_initializer(page, page->uninit.type, NULL);
+	page->anon.slot = from->anon.slot;
+	lock_acquire(&swap_lock);
+	share_slot(page->anon.slot);
+	lock_release(&swap_lock);
+}
+
+/* Give DST, the current thread's uninit copy of SRC made by fork, the contents
+ * of SRC, an anonymous page that is swapped out : the zero flag, a copy of the
+ * compressed contents, or a share of the swap slot, which a read-ahead copy in
+ * the swap cache leaves in place. Returns false if out of memory. */
+bool
+anon_fork_swapped (struct page *dst, struct page *src) {
+	struct anon_page *anon = &src->anon;
+	struct zswap_entry *e, *copy = NULL;
+	bool ok = true;
+	ASSERT(VM_TYPE(dst->operations->type) == VM_UNINIT);
+	dst->uninit.page_initializer(dst, dst->uninit.type, NULL);
+	if(anon->zero){
+		dst->anon.zero = true;
+		return true;
+	}
+	lock_acquire(&zswap_lock);	//A writeback moves the contents from the pool to a slot.
+	e = anon->zswap;
+	if(e != NULL){
+		copy = malloc(sizeof *e + e->size);
+		ok = copy != NULL;
+		if(ok){
+			copy->page = dst;
+			copy->size = e->size;
+			memcpy(copy->data, e->data, e->size);
+			list_push_back(&zswap_lru, &copy->elem);
+			dst->anon.zswap = copy;
+			zswap_cnt++;
+			zswap_bytes += sizeof *e + e->size;
+			zswap_fork_cnt++;
+		}
 	}
-	disk_sector_t sec_no = slot->slotNo * SECTORS_PER_PAGE;		//set sector Number : slotNo * 8
-	//printf("Swapping out ANON-PAGE 0x%X to swap slot %d <-> sector %d\n", page->va, slot->slotNo, sec_no);
-	void* buffer = page->frame->kva;
-	for(i = 0; i < SECTORS_PER_PAGE; i++){	//USE : void disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
-		disk_write(swap_disk, sec_no, buffer);
-		buffer += DISK_SECTOR_SIZE;
-		sec_no++;
+	else if(anon->slot != NO_SLOT){
+		dst->anon.slot = anon->slot;
+		lock_acquire(&swap_lock);
+		share_slot(dst->anon.slot);
+		lock_release(&swap_lock);
 	}
-	anon_page->slot = slot;		//save slot to anon_page.
-	page->frame = NULL;
-	return true;
+	lock_release(&zswap_lock);
+	return ok;
+}
+
+/* Write the CNT pages in PAGES to the swap disk as described above. */
+static size_t
+swap_write_batch (struct page *pages[], size_t cnt) {
+	struct disk_iovec iov[SWAP_BATCH];
+	size_t slot = NO_SLOT, i;
+	for(; cnt > 0; cnt /= 2){			//get a swap slot for each page;
+		slot = get_available_slots(cnt);
+		if(slot != NO_SLOT){
+			break;
+		}
+	}
+	if(slot == NO_SLOT){
+		//printf("ANON-PAGE 0x%X Failed to get a swap-slot!!\n", pages[0]->va);
+		return 0;
+	}
+	disk_sector_t sec_no = slot * SECTORS_PER_PAGE;		//set sector Number : slot * 8
+	//printf("Swapping out %d ANON-PAGEs from 0x%X to swap slot %d <-> sector %d\n", cnt, pages[0]->va, slot, sec_no);
+	for(i = 0; i < cnt; i++){
+		iov[i].buffer = pages[i]->frame->kva;
+		iov[i].sector_cnt = SECTORS_PER_PAGE;
+	}
+	disk_writev(swap_disk, sec_no, iov, cnt);	//All pages in one request.
+	for(i = 0; i < cnt; i++){
+		pages[i]->anon.slot = slot + i;		//save slot to anon_page.
+		pages[i]->frame = NULL;
+	}
+	swap_out_cnt += cnt;
+	swap_batch_cnt++;
+	return cnt;
+}
+
+/* Map LENGTH bytes of zero-filled memory at ADDR, for mmap(MAP_ANONYMOUS).
+ * The pages are lazy anonymous pages with no file, that read the shared zero
+ * page until first written. Their LAZY_AUX only marks where the mapping ends,
+ * like a file mapping's, so all the pages but the last share one record, and
+ * the last one another. Returns ADDR, or NULL if the range is bad or taken. */
+void *
+do_mmap_anon (void *addr, size_t length, bool writable) {
+	struct lazy_aux* AUX[2];	//[0] : pages followed by another, [1] : the last one.
+	size_t pages = DIV_ROUND_UP(length, PGSIZE), i, j;
+	uint8_t* upage = addr;
+	bool success = true;
+	//1. FAIL if addr isn't page-aligned or is 0, or the range is empty or reaches the kernel.
+	if(addr == NULL || pg_ofs(addr) != 0 || length == 0 || upage + pages * PGSIZE <= upage
+			|| !is_user_vaddr(upage + pages * PGSIZE - 1)){
+		return NULL;
+	}
+	//2. FAIL if any page overlaps with current spt pages.
+	for(i = 0; i < pages; i++){
+		if(spt_find_page(&thread_current()->spt, upage + i * PGSIZE) != NULL){
+			return NULL;
+		}
+	}
+	//3. Set up the two LAZY_AUX's. Ours is the first reference.
+	for(j = 0; j < 2; j++){
+		AUX[j] = malloc(sizeof(struct lazy_aux));
+		if(AUX[j] == NULL){
+			if(j == 1){
+				free(AUX[0]);
+			}
+			return NULL;
+		}
+		AUX[j]->executable = NULL;
+		AUX[j]->page_read_bytes = 0;
+		AUX[j]->page_zero_bytes = PGSIZE;
+		AUX[j]->offset = 0;
+		AUX[j]->next_page = j == 0;
+		AUX[j]->ref_cnt = 1;
+		AUX[j]->own_file = false;
+	}
+	//4. Allocate the pages. Undo them all if one fails.
+	for(i = 0; success && i < pages; i++){
+		struct lazy_aux* aux = lazy_aux_get(AUX[i == pages - 1]);
+		success = vm_alloc_page_with_initializer(VM_ANON | VM_ANON_MAP, upage + i * PGSIZE, writable, vm_zero_fill, aux);
+		if(!success){
+			lazy_aux_put(aux);
+			while(i-- > 0){
+				vm_unmap_page(spt_find_page(&thread_current()->spt, upage + i * PGSIZE));
+			}
+		}
+	}
+	lazy_aux_put(AUX[0]);
+	lazy_aux_put(AUX[1]);
+	return success ? addr : NULL;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
-	if(anon_page->aux != NULL){
-		free(anon_page->aux);
+	lazy_aux_put(anon_page->aux);
+	zswap_drop(page);		//First : a writeback would give it a slot.
+	ksm_drop(page);
+	text_drop(page);
+	vm_rmap_remove(page);		//Others may keep the frame.
+	if(anon_page->cache != NULL){	//Read ahead but never used.
+		lock_acquire(&swap_lock);
+		void* cache = swap_cache_drop(anon_page);
+		lock_release(&swap_lock);
+		palloc_free_page(cache);
+	}
+	if(anon_page->slot != NO_SLOT){	//Swapped out : the contents are no longer needed.
+		free_slot(anon_page->slot);
 	}
 	if(page->frame != NULL){
 		vm_dealloc_frame(page->frame);
 	}
 	//pml4_clear_page(thread_current()->pml4, page->va);
 }
+
+/* Returns true if the page at KVA is all zeros. */
+static bool is_zero_page(const void* kva){
+	const uint64_t* p = kva;
+	size_t i;
+	for(i = 0; i < PGSIZE / sizeof *p; i++){
+		if(p[i] != 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Write the least recently stored page in the pool out to the swap disk and free
+ * its entry. Called with zswap_lock held. Returns false if the swap disk is full. */
+static bool zswap_writeback(void){
+	struct zswap_entry* e = list_entry(list_front(&zswap_lru), struct zswap_entry, elem);
+	size_t slot = get_available_slots(1);
+	if(slot == NO_SLOT){
+		return false;
+	}
+	size_t size = lz_decompress(e->data, e->size, zswap_page, PGSIZE);
+	ASSERT(size == PGSIZE);
+	disk_write_multiple(swap_disk, slot * SECTORS_PER_PAGE, zswap_page, SECTORS_PER_PAGE);
+	e->page->anon.slot = slot;
+	e->page->anon.zswap = NULL;
+	list_remove(&e->elem);
+	zswap_cnt--;
+	zswap_bytes -= sizeof *e + e->size;
+	free(e);
+	zswap_writeback_cnt++;
+	swap_out_cnt++;
+	swap_batch_cnt++;
+	return true;
+}
+
+/* Swap out PAGE, which is in a frame, to the zswap pool, making room by writing
+ * the oldest pages in the pool to disk. Returns false, leaving PAGE alone, if it
+ * does not compress well enough or the pool cannot take it. */
+static bool zswap_store(struct page* page){
+	void* kva = page->frame->kva;
+	size_t size;
+	if(is_zero_page(kva)){
+		page->anon.zero = true;
+		zswap_zero_cnt++;
+		return true;
+	}
+	lock_acquire(&zswap_lock);
+	size = lz_compress(kva, PGSIZE, zswap_buf, ZSWAP_MAX_SIZE, zswap_work);
+	if(size == 0){
+		zswap_reject_cnt++;
+		lock_release(&zswap_lock);
+		return false;
+	}
+	size_t need = sizeof(struct zswap_entry) + size;
+	while(zswap_bytes + need > vm_zswap_pages * PGSIZE && !list_empty(&zswap_lru)){
+		if(!zswap_writeback()){
+			break;
+		}
+	}
+	struct zswap_entry* e = NULL;
+	if(zswap_bytes + need <= vm_zswap_pages * PGSIZE){
+		e = malloc(need);
+	}
+	if(e != NULL){
+		e->page = page;
+		e->size = size;
+		memcpy(e->data, zswap_buf, size);
+		list_push_back(&zswap_lru, &e->elem);
+		page->anon.zswap = e;
+		zswap_cnt++;
+		zswap_bytes += need;
+		zswap_store_cnt++;
+		zswap_orig_bytes += PGSIZE;
+		zswap_comp_bytes += size;
+	}
+	lock_release(&zswap_lock);
+	return e != NULL;
+}
+
+/* If PAGE is in the zswap pool, decompress it into KVA, take it out of the pool
+ * and return true. */
+static bool zswap_load(struct page* page, void* kva){
+	struct zswap_entry* e;
+	lock_acquire(&zswap_lock);
+	e = page->anon.zswap;
+	if(e != NULL){
+		size_t size = lz_decompress(e->data, e->size, kva, PGSIZE);
+		ASSERT(size == PGSIZE);
+		list_remove(&e->elem);
+		zswap_cnt--;
+		zswap_bytes -= sizeof *e + e->size;
+		page->anon.zswap = NULL;
+		zswap_hit_cnt++;
+	}
+	lock_release(&zswap_lock);
+	free(e);
+	return e != NULL;
+}
+
+/* Forget PAGE's copy in the zswap pool, if any. */
+static void zswap_drop(struct page* page){
+	struct zswap_entry* e;
+	lock_acquire(&zswap_lock);
+	e = page->anon.zswap;
+	if(e != NULL){
+		list_remove(&e->elem);
+		zswap_cnt--;
+		zswap_bytes -= sizeof *e + e->size;
+		page->anon.zswap = NULL;
+	}
+	lock_release(&zswap_lock);
+	free(e);
+}
+
+/* Print swap statistics. */
+void
+vm_anon_print_stats (void) {
+	printf("Swap: %zu of %zu slots in use, %zu at most, %lld out in %lld writes, %lld in, %lld shared\n",
+			swap_used, nSlots, swap_high, swap_out_cnt, swap_batch_cnt, swap_in_cnt, slot_share_cnt);
+	printf("Swap readahead: %lld pages, %lld hits, %lld wasted, %zu cached, window %zu\n",
+			ra_cnt, ra_hit_cnt, ra_waste_cnt, swap_cache_cnt, ra_window);
+	if(vm_zswap_pages > 0){
+		long long hits = zswap_hit_cnt + zswap_zero_hit_cnt;
+		long long ins = hits + swap_in_cnt;
+		printf("Zswap: %zu pages in %zu of %zu bytes, %lld stored at %lld%% size, %lld zero, "
+				"%lld rejected, %lld written back\n",
+				zswap_cnt, zswap_bytes, vm_zswap_pages * PGSIZE, zswap_store_cnt,
+				zswap_orig_bytes > 0 ? zswap_comp_bytes * 100 / zswap_orig_bytes : 0,
+				zswap_zero_cnt, zswap_reject_cnt, zswap_writeback_cnt);
+		printf("Zswap: %lld pages copied for forked children\n", zswap_fork_cnt);
+		printf("Zswap: %lld of %lld swap-ins from memory (%lld%%), %lld disk writes avoided\n",
+				hits, ins, ins > 0 ? hits * 100 / ins : 0,
+				zswap_store_cnt + zswap_zero_cnt - zswap_writeback_cnt);
+	}
+}
@@ -59,8 +59,7 @@ file_map_swap_in (struct page *page, void *kva) {
 	struct file* file = file_page->file;
 	if (kpage == NULL)
 		return false;
-	file_seek(file, ofs);
-	int read = file_read (file, kpage, page_read_bytes);
+	int read = file_read_at (file, kpage, page_read_bytes, ofs);	//The file may be shared with forked children.
 	if (read != (int) page_read_bytes) {
 		//printf("load failed @ page 0x%X, read %d bytes instead of %d..\n", page->va, read, page_read_bytes);
 		return false;
@@ -71,17 +70,20 @@ file_map_swap_in (struct page *page, void *kva) {
 	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.
+ * The page need not belong to the current thread : the evicting thread may be
+ * another process or kswapd, so go through the frame's owner and kernel address. */
 static bool
 file_map_swap_out (struct page *page) {
 	struct file_page *file_page = &page->file;
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){	//Write back contents to file, if DIRTY.
-		off_t written = file_write_at(file_page->file, page->va, file_page->read_bytes, file_page->aux->offset);
+	uint64_t *pml4 = page->frame->owner->pml4;
+	if(pml4_is_dirty(pml4, page->va)){	//Write back contents to file, if DIRTY.
+		off_t written = file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->aux->offset);
 		if((size_t) written != file_page->read_bytes){
 			//printf("SWAP-OUT page 0x%X -> read_bytes : %d, offset : %d, WRITTEN : %d bytes.\n", page->va, file_page->read_bytes, file_page->aux->offset, written);
 			return false;
 		}
-		pml4_set_dirty(thread_current()->pml4, page->va, false);
+		pml4_set_dirty(pml4, page->va, false);
 	}
 	file_page->swapped_out = true;				//mark TRUE for later SWAP-IN's.
 	page->frame = NULL;
@@ -92,16 +94,12 @@ file_map_swap_out (struct page *page) {
 static void
 file_map_destroy (struct page *page) {
 	struct file_page *file_page = &page->file;
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){	//Write back contents to file, if DIRTY.
-		file_write_at(file_page->file, page->va, file_page->read_bytes, file_page->aux->offset);
+	vm_rmap_remove(page);	//Others may keep the frame, and its contents.
+	if(page->frame != NULL && pml4_is_dirty(thread_current()->pml4, page->va)){	//Write back contents to file, if DIRTY.
+		file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->aux->offset);
 		pml4_set_dirty(thread_current()->pml4, page->va, false);
 	}
-	if(file_page->aux != NULL){	//free the LAZY_AUX.
-		free(file_page->aux);
-	}
-	if(file_page->file != NULL){	//close the file.
-		file_close(file_page->file);
-	}
+	lazy_aux_put(file_page->aux);	//free the LAZY_AUX, and close the file with the last one.
 	if(page->frame != NULL){
 		vm_dealloc_frame(page->frame);
 	}
@@ -118,9 +116,8 @@ static bool file_lazy_load (struct page *page, void *aux) {
 	//printf("LOADING addr : 0x%X, read_bytes : %d, zero_bytes : %d, ofs : %d\n", page->va, page_read_bytes, page_zero_bytes, ofs);
 	if (kpage == NULL)
 		return false;
-	// Load this page.
-	file_seek(file, ofs);
-	int read = file_read (file, kpage, page_read_bytes);
+	// Load this page. The file may be shared with forked children : no seeking.
+	int read = file_read_at (file, kpage, page_read_bytes, ofs);
 	if (read != (int) page_read_bytes) {
 		printf("load failed @ page 0x%X, read %d bytes instead of %d..\n", page->va, read, page_read_bytes);
 		return false;
@@ -167,6 +164,8 @@ do_mmap (void *addr, size_t length, int writable,
 		AUX->page_zero_bytes = page_zero_bytes;
 		AUX->offset = ofs;
 		AUX->next_page = read_bytes > PGSIZE ? true : false;
+		AUX->ref_cnt = 1;
+		AUX->own_file = true;
 		aux = AUX;
 		if (!vm_alloc_page_with_initializer (VM_FILE, upage, writable, file_lazy_load, aux)){
 			return NULL;
@@ -186,10 +185,10 @@ do_munmap (void *addr) {
 	struct page* page = spt_find_page(&thread_current()->spt, uaddr);
 	lock_acquire(&filesys_lock);
 	while(page != NULL){
-		if(page_get_type(page) == VM_FILE){
+		if(page_get_type(page) == VM_FILE || (page->uninit.type & VM_ANON_MAP)){	//File or anonymous mapping.
 			struct lazy_aux* AUX = page->uninit.aux;
 			next_page = AUX->next_page;
-			spt_remove_page(&thread_current()->spt, page);
+			vm_unmap_page(page);
 		}
 		else{
 			//printf("page addr : 0x%X is not a file-mapped page.\n", uaddr);
@@ -0,0 +1,355 @@
+/* ksm.c: Same-page merging of identical anonymous frames. */
+
+#include "vm/ksm.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "vm/vm.h"
+
+/* Frames looked at per batch.  The scanner holds the frame table
+   lock for one batch at a time. */
+#define KSM_BATCH 64
+
+/* A frame shared by merged pages.  It belongs to the merging code,
+   not the frame table, so it is never evicted; it goes back to
+   the user pool when the last page sharing it is unmerged or
+   destroyed. */
+struct ksm_node {
+	void *kva;                  /* Shared contents. */
+	uint64_t sum;               /* hash_bytes() of the contents. */
+	size_t ref_cnt;             /* Pages mapping it. */
+	struct hash_elem elem;      /* Element in stable. */
+};
+
+unsigned vm_ksm_budget;
+
+/* Shared frames, by contents.  Protected by ksm_lock. */
+static struct hash stable;
+static struct lock ksm_lock;
+
+/* Frames whose contents held still for one visit, by contents,
+   waiting for a twin.  A frame's ksm_sum stays as it was when it
+   was inserted for as long as it is here, even if its contents
+   change.  Emptied at the start of each pass over the
+   frame table.  Protected by the frame table lock, like the scan
+   cursor. */
+static struct hash unstable;
+static struct list_elem *cursor;    /* Next frame to look at. */
+
+/* Statistics. */
+static long long scan_cnt;          /* Frames looked at. */
+static long long volatile_cnt;      /* Frames skipped as still changing. */
+static long long merge_cnt;         /* Pages merged. */
+static long long unmerge_cnt;       /* Merged pages written to. */
+static long long pass_cnt;          /* Passes over the frame table. */
+static long long sleep_ticks;       /* Ticks slept to stay in budget. */
+static size_t shared_cnt;           /* Shared frames... */
+static size_t sharing_cnt;          /* ...and pages mapping them. */
+
+static void ksm_thread (void *aux);
+static void scan_frame (struct frame *);
+
+static uint64_t
+node_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct ksm_node, elem)->sum;
+}
+
+/* Orders elements by address: insertion and deletion go by
+   identity, and only lookups compare contents. */
+static bool
+elem_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return a < b;
+}
+
+/* Does node E hold the page at KVA? */
+static bool
+node_equal (const struct hash_elem *e, const void *kva, void *aux UNUSED) {
+	return !memcmp (hash_entry (e, struct ksm_node, elem)->kva, kva, PGSIZE);
+}
+
+static uint64_t
+frame_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Does frame E hold the page at KVA? */
+static bool
+frame_equal (const struct hash_elem *e, const void *kva, void *aux UNUSED) {
+	return !memcmp (hash_entry (e, struct frame, ksm_elem)->kva, kva, PGSIZE);
+}
+
+/* Sets up the tables, and starts the scanner if -ksm was given. */
+void
+ksm_init (void) {
+	hash_init (&stable, node_hash, elem_less, NULL);
+	hash_init (&unstable, frame_hash, elem_less, NULL);
+	lock_init (&ksm_lock);
+	if (vm_ksm_budget > 100)
+		vm_ksm_budget = 100;
+	if (vm_ksm_budget > 0)
+		thread_create ("ksmd", PRI_DEFAULT, ksm_thread, NULL);
+}
+
+/* Forgets FRAME, which is leaving the frame table.  Called with
+   the frame table lock held. */
+void
+ksm_frame_unlinked (struct frame *frame) {
+	if (cursor == &frame->elem)
+		cursor = list_next (cursor);
+	if (frame->ksm_candidate) {
+		hash_delete (&unstable, &frame->ksm_elem);
+		frame->ksm_candidate = false;
+	}
+	frame->ksm_sum = 0;
+}
+
+static void
+clear_candidate (struct hash_elem *e, void *aux UNUSED) {
+	hash_entry (e, struct frame, ksm_elem)->ksm_candidate = false;
+}
+
+/* Scanner thread.  Looks at KSM_BATCH frames at a time, then
+   sleeps long enough that the time spent scanning stays within
+   vm_ksm_budget percent.  Batches are timed in whole ticks,
+   rounding up, so the scanner errs on the side of sleeping. */
+static void
+ksm_thread (void *aux UNUSED) {
+	for (;;) {
+		int64_t start = timer_ticks ();
+		int64_t ticks;
+		int i;
+
+		lock_acquire (&frame_lock);
+		for (i = 0; i < KSM_BATCH && !list_empty (&frame_list); i++) {
+			struct frame *frame;
+
+			if (cursor == NULL || cursor == list_end (&frame_list)) {
+				hash_clear (&unstable, clear_candidate);
+				cursor = list_begin (&frame_list);
+				pass_cnt++;
+			}
+			frame = list_entry (cursor, struct frame, elem);
+			cursor = list_next (cursor);
+			scan_frame (frame);
+		}
+		lock_release (&frame_lock);
+
+		ticks = (timer_elapsed (start) + 1) * (100 - vm_ksm_budget)
+			/ vm_ksm_budget;
+		if (ticks < 1)
+			ticks = 1;
+		sleep_ticks += ticks;
+		timer_sleep (ticks);
+	}
+}
+
+/* Returns true if PAGE, in FRAME, is mapped writable by its own
+   4 kB page table entry, which rules out pages shared copy-on-write
+   with a forked process and pieces of huge pages. */
+static bool
+mapped_private (struct frame *frame, struct page *page) {
+	uint64_t *pte = pml4e_walk (frame->owner->pml4, (uint64_t) page->va, 0);
+	return frame->map_cnt == 1 && pte != NULL
+		&& (*pte & (PTE_P | PTE_W | PTE_PS)) == (PTE_P | PTE_W)
+		&& ptov (PTE_ADDR (*pte)) == frame->kva;
+}
+
+/* Makes FRAME's page share NODE's frame instead, if their contents
+   are still the same, and frees FRAME.  Called with the frame table
+   lock and ksm_lock held.  With interrupts off, the owner cannot
+   write to the page between the comparison and the remapping. */
+static bool
+merge (struct frame *frame, struct ksm_node *node) {
+	struct page *page = frame->page;
+	enum intr_level old_level;
+	bool same;
+
+	old_level = intr_disable ();
+	same = mapped_private (frame, page)
+		&& !memcmp (frame->kva, node->kva, PGSIZE);
+	if (same) {
+		pml4_set_page (frame->owner->pml4, page->va, node->kva, false);
+		page->frame = NULL;
+		page->anon.ksm = node;
+		node->ref_cnt++;
+	}
+	intr_set_level (old_level);
+	if (!same)
+		return false;
+
+	vm_unlink_frame (frame);
+	vm_rmap_clear (frame, false);
+	palloc_free_page (frame->kva);
+	free (frame);
+	merge_cnt++;
+	sharing_cnt++;
+	return true;
+}
+
+/* Turns FRAME, whose contents match another frame's, into a shared
+   frame with FRAME's page as its first user.  Returns the new node,
+   or a null pointer if FRAME no longer qualifies or memory runs
+   out.  Called with the frame table lock and ksm_lock held. */
+static struct ksm_node *
+make_shared (struct frame *frame) {
+	struct page *page = frame->page;
+	struct ksm_node *node = malloc (sizeof *node);
+	enum intr_level old_level;
+	bool ok;
+
+	if (node == NULL)
+		return NULL;
+	node->kva = frame->kva;
+	node->ref_cnt = 1;
+
+	old_level = intr_disable ();
+	ok = mapped_private (frame, page);
+	if (ok) {
+		pml4_set_page (frame->owner->pml4, page->va, frame->kva, false);
+		page->frame = NULL;
+		page->anon.ksm = node;
+	}
+	intr_set_level (old_level);
+	if (!ok) {
+		free (node);
+		return NULL;
+	}
+
+	vm_unlink_frame (frame);
+	vm_rmap_clear (frame, false);
+	free (frame);
+	node->sum = hash_bytes (node->kva, PGSIZE);	/* Read-only now. */
+	hash_insert (&stable, &node->elem);
+	merge_cnt++;
+	shared_cnt++;
+	sharing_cnt++;
+	return node;
+}
+
+/* Looks at FRAME: merges it with an identical shared frame or
+   candidate if there is one, or else makes it a candidate if its
+   contents have not changed since the last visit.  Called with
+   the frame table lock held. */
+static void
+scan_frame (struct frame *frame) {
+	struct page *page = frame->page;
+	struct hash_elem *e;
+	uint64_t sum;
+
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_ANON
+			|| !page->writable || !mapped_private (frame, page))
+		return;
+	scan_cnt++;
+
+	sum = hash_bytes (frame->kva, PGSIZE);
+	if (sum != frame->ksm_sum) {
+		if (frame->ksm_candidate) {
+			hash_delete (&unstable, &frame->ksm_elem);
+			frame->ksm_candidate = false;
+		}
+		frame->ksm_sum = sum;
+		volatile_cnt++;
+		return;
+	}
+
+	lock_acquire (&ksm_lock);
+	e = hash_lookup (&stable, sum, node_equal, frame->kva, NULL);
+	if (e != NULL)
+		merge (frame, hash_entry (e, struct ksm_node, elem));
+	else if (!frame->ksm_candidate) {
+		e = hash_lookup (&unstable, sum, frame_equal, frame->kva, NULL);
+		if (e != NULL) {
+			struct frame *twin = hash_entry (e, struct frame, ksm_elem);
+			struct ksm_node *node = make_shared (twin);
+
+			if (node != NULL)
+				merge (frame, node);
+		}
+		else if (hash_insert (&unstable, &frame->ksm_elem) == NULL)
+			frame->ksm_candidate = true;
+	}
+	lock_release (&ksm_lock);
+}
+
+/* Drops a reference to NODE, freeing it with the last one. */
+static void
+node_put (struct ksm_node *node) {
+	bool last;
+
+	lock_acquire (&ksm_lock);
+	last = --node->ref_cnt == 0;
+	sharing_cnt--;
+	if (last) {
+		hash_delete (&stable, &node->elem);
+		shared_cnt--;
+	}
+	lock_release (&ksm_lock);
+	if (last) {
+		palloc_free_page (node->kva);
+		free (node);
+	}
+}
+
+/* Gives DST, the current thread's copy of merged page SRC made by
+   fork, a frame of its own with SRC's contents.  The child does
+   not join the sharing: the scanner will find it again. */
+bool
+ksm_copy (struct page *dst, struct page *src) {
+	if (!vm_claim_page (dst->va))
+		return false;
+	memcpy (dst->frame->kva, src->anon.ksm->kva, PGSIZE);
+	return true;
+}
+
+/* Handles a write to merged PAGE of the current thread by giving
+   it a private copy of the shared frame. */
+bool
+ksm_unmerge (struct page *page) {
+	struct ksm_node *node = page->anon.ksm;
+
+	pml4_clear_page (thread_current ()->pml4, page->va);
+	page->anon.ksm = NULL;
+	if (!vm_claim_page (page->va)) {
+		node_put (node);
+		return false;
+	}
+	memcpy (page->frame->kva, node->kva, PGSIZE);
+	node_put (node);
+	unmerge_cnt++;
+	return true;
+}
+
+/* Takes PAGE, of the current thread, out of the sharing if it is
+   merged, when it is destroyed. */
+void
+ksm_drop (struct page *page) {
+	struct ksm_node *node = page->anon.ksm;
+
+	if (node == NULL)
+		return;
+	pml4_clear_page (thread_current ()->pml4, page->va);
+	page->anon.ksm = NULL;
+	node_put (node);
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) {
+	if (vm_ksm_budget == 0)
+		return;
+	printf ("KSM: %lld frames scanned in %lld passes, %lld still changing, "
+			"%lld ticks asleep\n",
+			scan_cnt, pass_cnt, volatile_cnt, sleep_ticks);
+	printf ("KSM: %lld pages merged, %lld unmerged, "
+			"%zu shared frames mapped by %zu pages\n",
+			merge_cnt, unmerge_cnt, shared_cnt, sharing_cnt);
+}
@@ -0,0 +1,190 @@
+/* radix.c: Radix tree keyed by user virtual page. */
+
+#include "vm/radix.h"
+#include <debug.h>
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+/* A node: interior nodes point to nodes one level down, leaves
+   (level 0) hold the values.  Exactly one page. */
+struct radix_node {
+	void *slots[RADIX_FANOUT];
+};
+
+/* Bytes of address space covered by one slot of a node at
+   LEVEL. */
+#define SLOT_SPAN(LEVEL) (1ULL << (PTXSHIFT + (LEVEL) * RADIX_BITS))
+
+/* First address past the tree's reach. */
+#define RADIX_LIMIT SLOT_SPAN (RADIX_LEVELS)
+
+/* Returns the index of VA's slot in a node at LEVEL. */
+static inline size_t
+slot_idx (uint64_t va, int level) {
+	return (va >> (PTXSHIFT + level * RADIX_BITS)) & (RADIX_FANOUT - 1);
+}
+
+/* Returns the leaf covering VA, or a null pointer if there is
+   none and CREATE is false or memory runs out. */
+static struct radix_node *
+find_leaf (struct radix_tree *tree, uint64_t va, bool create) {
+	struct radix_node **link = &tree->root;
+	int level;
+
+	if (tree->hint != NULL && (va & ~(SLOT_SPAN (1) - 1)) == tree->hint_base)
+		return tree->hint;
+
+	for (level = RADIX_LEVELS - 1; ; level--) {
+		if (*link == NULL) {
+			if (!create)
+				return NULL;
+			*link = palloc_get_page (PAL_ZERO);
+			if (*link == NULL)
+				return NULL;
+		}
+		if (level == 0)
+			break;
+		link = (struct radix_node **) &(*link)->slots[slot_idx (va, level)];
+	}
+
+	tree->hint = *link;
+	tree->hint_base = va & ~(SLOT_SPAN (1) - 1);
+	return *link;
+}
+
+/* Initializes TREE as an empty tree.  Allocates nothing until the
+   first insertion. */
+void
+radix_init (struct radix_tree *tree) {
+	tree->root = NULL;
+	tree->cnt = 0;
+	tree->hint = NULL;
+	tree->hint_base = 0;
+}
+
+/* Returns the value stored for the page containing VA, or a null
+   pointer if there is none. */
+void *
+radix_lookup (struct radix_tree *tree, const void *va) {
+	struct radix_node *leaf;
+
+	ASSERT (is_user_vaddr (va));
+
+	leaf = find_leaf (tree, (uint64_t) va, false);
+	return leaf != NULL ? leaf->slots[slot_idx ((uint64_t) va, 0)] : NULL;
+}
+
+/* Stores V, which must not be null, for the page containing VA.
+   Returns false if the page already has a value or a node could
+   not be allocated. */
+bool
+radix_insert (struct radix_tree *tree, const void *va, void *v) {
+	struct radix_node *leaf;
+	void **slot;
+
+	ASSERT (is_user_vaddr (va));
+	ASSERT (v != NULL);
+
+	leaf = find_leaf (tree, (uint64_t) va, true);
+	if (leaf == NULL)
+		return false;
+	slot = &leaf->slots[slot_idx ((uint64_t) va, 0)];
+	if (*slot != NULL)
+		return false;
+	*slot = v;
+	tree->cnt++;
+	return true;
+}
+
+/* Removes and returns the value stored for the page containing
+   VA, or returns a null pointer if there is none. */
+void *
+radix_remove (struct radix_tree *tree, const void *va) {
+	struct radix_node *leaf;
+	void **slot, *v;
+
+	ASSERT (is_user_vaddr (va));
+
+	leaf = find_leaf (tree, (uint64_t) va, false);
+	if (leaf == NULL)
+		return NULL;
+	slot = &leaf->slots[slot_idx ((uint64_t) va, 0)];
+	v = *slot;
+	if (v != NULL) {
+		*slot = NULL;
+		tree->cnt--;
+	}
+	return v;
+}
+
+/* Finds the value for the lowest page at or above *VA, sets *VA
+   to that page and returns the value.  Returns a null pointer if
+   there is none.  Empty subtrees are skipped whole, so
+
+     for (va = start; (v = radix_next (tree, &va)) != NULL
+          && va < end; va += PGSIZE)
+
+   visits a range in order at a cost proportional to the number
+   of leaves it touches. */
+void *
+radix_next (struct radix_tree *tree, void **va_) {
+	uint64_t va = (uint64_t) pg_round_down (*va_);
+
+	while (va < RADIX_LIMIT) {
+		struct radix_node *node = tree->root;
+		int level;
+		size_t i;
+
+		/* Descend, skipping past the first missing subtree. */
+		for (level = RADIX_LEVELS - 1; node != NULL && level > 0; level--) {
+			struct radix_node *child = node->slots[slot_idx (va, level)];
+			if (child == NULL)
+				break;
+			node = child;
+		}
+		if (node == NULL)
+			return NULL;
+		if (level > 0) {
+			va = (va & ~(SLOT_SPAN (level) - 1)) + SLOT_SPAN (level);
+			continue;
+		}
+
+		/* Scan the rest of the leaf. */
+		for (i = slot_idx (va, 0); i < RADIX_FANOUT; i++)
+			if (node->slots[i] != NULL) {
+				*va_ = (void *) ((va & ~(SLOT_SPAN (1) - 1)) + i * PGSIZE);
+				return node->slots[i];
+			}
+		va = (va & ~(SLOT_SPAN (1) - 1)) + SLOT_SPAN (1);
+	}
+	return NULL;
+}
+
+/* Frees the subtree rooted at NODE at LEVEL, calling DESTRUCTOR,
+   if nonnull, on each value. */
+static void
+destroy_node (struct radix_node *node, int level,
+		radix_action_func *destructor) {
+	size_t i;
+
+	for (i = 0; i < RADIX_FANOUT; i++) {
+		if (node->slots[i] == NULL)
+			continue;
+		if (level > 0)
+			destroy_node (node->slots[i], level - 1, destructor);
+		else if (destructor != NULL)
+			destructor (node->slots[i]);
+	}
+	palloc_free_page (node);
+}
+
+/* Calls DESTRUCTOR, if nonnull, on each value in TREE, then frees
+   TREE's nodes and leaves it empty.  DESTRUCTOR must not use
+   TREE. */
+void
+radix_destroy (struct radix_tree *tree, radix_action_func *destructor) {
+	if (tree->root != NULL)
+		destroy_node (tree->root, RADIX_LEVELS - 1, destructor);
+	radix_init (tree);
+}
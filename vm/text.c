@@ -0,0 +1,321 @@
+/* text.c: Read-only executable pages shared between processes. */
+
+#include "vm/text.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* A cached page of executable text. */
+struct text_frame {
+	struct inode *inode;        /* File it was read from... */
+	off_t offset;               /* ...at this offset... */
+	size_t read_bytes;          /* ...this many bytes, the rest zeros. */
+	void *kva;                  /* Contents. */
+	struct list sharers;        /* Pages mapping it, by anon.text_elem. */
+	size_t ref_cnt;             /* Number of sharers. */
+	struct hash_elem elem;      /* Element in frames. */
+	struct list_elem lru_elem;  /* Element in lru. */
+};
+
+bool vm_share_text;
+
+/* The cache, by inode and offset, and its clock, least recently
+   looked at first.  Protected by text_lock, as are the sharer
+   lists and the anon.text fields of the pages on them. */
+static struct hash frames;
+static struct list lru;
+static struct lock text_lock;
+
+/* Statistics. */
+static long long load_cnt;          /* Pages read into new frames. */
+static long long hit_cnt;           /* Faults that found the page cached. */
+static long long fork_cnt;          /* Pages shared with forked children. */
+static long long reclaim_cnt;       /* Frames reclaimed. */
+static size_t sharing_cnt;          /* Pages mapping cached frames. */
+
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct text_frame *t = hash_entry (e, struct text_frame, elem);
+	return hash_u64 ((uint64_t) t->inode + t->offset);
+}
+
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct text_frame *a = hash_entry (a_, struct text_frame, elem);
+	const struct text_frame *b = hash_entry (b_, struct text_frame, elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->offset != b->offset)
+		return a->offset < b->offset;
+	return a->read_bytes < b->read_bytes;
+}
+
+void
+text_init (void) {
+	hash_init (&frames, text_hash, text_less, NULL);
+	list_init (&lru);
+	lock_init (&text_lock);
+}
+
+/* Returns the cached frame for the page described by AUX, or a
+   null pointer.  Called with text_lock held. */
+static struct text_frame *
+lookup (const struct lazy_aux *aux) {
+	struct text_frame key;
+	struct hash_elem *e;
+
+	key.inode = file_get_inode (aux->executable);
+	key.offset = aux->offset;
+	key.read_bytes = aux->page_read_bytes;
+	e = hash_find (&frames, &key.elem);
+	return e != NULL ? hash_entry (e, struct text_frame, elem) : NULL;
+}
+
+/* Makes PAGE, an uninitialized page of the current thread, an
+   anonymous page that maps T.  Called with text_lock held. */
+static bool
+attach (struct page *page, struct text_frame *t) {
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	if (!pml4_set_page (pml4, page->va, t->kva, false))
+		return false;
+	anon_initializer (page, page->uninit.type, NULL);
+	page->anon.text = t;
+	page->anon.text_pml4 = pml4;
+	list_push_back (&t->sharers, &page->anon.text_elem);
+	t->ref_cnt++;
+	sharing_cnt++;
+	return true;
+}
+
+/* Loads PAGE, a read-only page of an executable segment of the
+   current thread that is not loaded yet, by mapping the cached copy,
+   reading it into a new cached frame first if there is none. */
+bool
+text_map (struct page *page) {
+	struct lazy_aux *aux = page->uninit.aux;
+	struct text_frame *t, *new;
+	bool ok;
+
+	lock_acquire (&text_lock);
+	t = lookup (aux);
+	if (t != NULL) {
+		ok = attach (page, t);
+		lock_release (&text_lock);
+		hit_cnt++;
+		return ok;
+	}
+	lock_release (&text_lock);
+
+	/* Read it without the lock: this may evict, and the disk is slow. */
+	new = malloc (sizeof *new);
+	if (new == NULL)
+		return false;
+	new->kva = vm_get_user_page ();
+	if (file_read_at (aux->executable, new->kva, aux->page_read_bytes,
+				aux->offset) != (off_t) aux->page_read_bytes) {
+		palloc_free_page (new->kva);
+		free (new);
+		return false;
+	}
+	memset ((uint8_t *) new->kva + aux->page_read_bytes, 0,
+			PGSIZE - aux->page_read_bytes);
+	new->inode = file_get_inode (aux->executable);
+	new->offset = aux->offset;
+	new->read_bytes = aux->page_read_bytes;
+	new->ref_cnt = 0;
+	list_init (&new->sharers);
+
+	/* Someone else may have loaded it meanwhile. */
+	lock_acquire (&text_lock);
+	t = lookup (aux);
+	if (t == NULL) {
+		if (hash_insert (&frames, &new->elem) != NULL) {
+			/* The cache is full and cannot grow. */
+			lock_release (&text_lock);
+			palloc_free_page (new->kva);
+			free (new);
+			return false;
+		}
+		t = new;
+		new = NULL;
+		list_push_back (&lru, &t->lru_elem);
+		load_cnt++;
+	}
+	ok = attach (page, t);
+	if (!ok && t->ref_cnt == 0) {
+		hash_delete (&frames, &t->elem);
+		list_remove (&t->lru_elem);
+		new = t;
+	}
+	lock_release (&text_lock);
+	if (new != NULL) {
+		palloc_free_page (new->kva);
+		free (new);
+	}
+	return ok;
+}
+
+/* Gives DST, the current thread's copy of SRC made by fork, the
+   frame SRC shares, if it still does. */
+bool
+text_copy (struct page *dst, struct page *src) {
+	bool ok = true;
+
+	lock_acquire (&text_lock);
+	if (VM_TYPE (src->operations->type) == VM_ANON && src->anon.text != NULL) {
+		ok = attach (dst, src->anon.text);
+		fork_cnt++;
+	}
+	lock_release (&text_lock);
+	return ok;
+}
+
+/* Removes PAGE from T's sharers and unmaps it, returning true if it
+   was the last one, in which case T is out of the cache and the
+   caller must free it.  Called with text_lock held. */
+static bool
+detach (struct page *page, struct text_frame *t) {
+	pml4_clear_page (page->anon.text_pml4, page->va);
+	list_remove (&page->anon.text_elem);
+	page->anon.text = NULL;
+	sharing_cnt--;
+	if (--t->ref_cnt > 0)
+		return false;
+	hash_delete (&frames, &t->elem);
+	list_remove (&t->lru_elem);
+	return true;
+}
+
+/* Takes PAGE out of the sharing, if it is shared, when it is
+   destroyed. */
+void
+text_drop (struct page *page) {
+	struct text_frame *t;
+	bool last = false;
+
+	lock_acquire (&text_lock);
+	t = page->anon.text;
+	if (t != NULL)
+		last = detach (page, t);
+	lock_release (&text_lock);
+	if (last) {
+		palloc_free_page (t->kva);
+		free (t);
+	}
+}
+
+/* Has any sharer of T accessed it since the last look?  Clears the
+   accessed bits.  Called with text_lock held. */
+static bool
+text_accessed (struct text_frame *t) {
+	struct list_elem *e;
+	bool accessed = false;
+
+	for (e = list_begin (&t->sharers); e != list_end (&t->sharers);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, anon.text_elem);
+		if (pml4_is_accessed (p->anon.text_pml4, p->va)) {
+			pml4_set_accessed (p->anon.text_pml4, p->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Turns PAGE, whose frame is being reclaimed, back into the
+   uninitialized page it was before its first fault.  uninit_new()
+   rebuilds the whole page, so the fields outside the union are
+   saved around it. */
+static void
+unload (struct page *page) {
+	struct hash_elem hash_elem = page->hash_elem;
+	bool writable = page->writable;
+	uint8_t advice = page->advice;
+
+	uninit_new (page, page->va, page->anon.init, page->anon.type,
+			page->anon.aux, anon_initializer);
+	page->hash_elem = hash_elem;
+	page->writable = writable;
+	page->advice = advice;
+}
+
+/* Has any sharer of T locked it in memory with mlock()?  Called
+   with text_lock held. */
+static bool
+text_mlocked (struct text_frame *t) {
+	struct list_elem *e;
+
+	for (e = list_begin (&t->sharers); e != list_end (&t->sharers);
+			e = list_next (e))
+		if (list_entry (e, struct page, anon.text_elem)->mlocked)
+			return true;
+	return false;
+}
+
+/* Frees one cached frame that none of its sharers accessed since
+   the clock last passed it or locked, unmapping it from all of
+   them.  Looks at every frame at most once.  Returns false if
+   there was none. */
+bool
+text_reclaim (void) {
+	struct text_frame *victim = NULL;
+	size_t n, i;
+
+	if (!vm_share_text)
+		return false;
+	lock_acquire (&text_lock);
+	n = list_size (&lru);
+	for (i = 0; i < n; i++) {
+		struct text_frame *t = list_entry (list_pop_front (&lru),
+				struct text_frame, lru_elem);
+		list_push_back (&lru, &t->lru_elem);
+		if (!text_accessed (t) && !text_mlocked (t)) {
+			victim = t;
+			break;
+		}
+	}
+	if (victim != NULL) {
+		bool last = false;
+
+		while (!last) {
+			struct page *p = list_entry (list_front (&victim->sharers),
+					struct page, anon.text_elem);
+			/* With interrupts off, the owner cannot fault on the
+			   page halfway through. */
+			enum intr_level old_level = intr_disable ();
+			last = detach (p, victim);
+			unload (p);
+			intr_set_level (old_level);
+		}
+		reclaim_cnt++;
+	}
+	lock_release (&text_lock);
+	if (victim == NULL)
+		return false;
+	palloc_free_page (victim->kva);
+	free (victim);
+	return true;
+}
+
+/* Prints text sharing statistics. */
+void
+text_print_stats (void) {
+	if (!vm_share_text)
+		return;
+	printf ("Text: %zu shared frames mapped by %zu pages; %lld loaded, "
+			"%lld found cached, %lld shared by fork, %lld reclaimed\n",
+			hash_size (&frames), sharing_cnt, load_cnt, hit_cnt, fork_cnt,
+			reclaim_cnt);
+}
@@ -75,12 +75,11 @@ uninit_destroy (struct page *page) {
 				pml4_set_dirty(thread_current()->pml4, page->va, false);
 			}
 		case VM_ANON :	//free the LAZY_AUX passed from lazy-loading.
-			if(uninit->aux != NULL){
-				free((struct lazy_aux*)uninit->aux);
-			}
+			lazy_aux_put(uninit->aux);
 			break;
 		default:
 			break;
 	}
+	vm_rmap_remove(page);	//If it was sharing a frame since a fork.
 	pml4_clear_page(thread_current()->pml4, page->va);
 }
@@ -7,10 +7,107 @@
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/interrupt.h"
+#include "filesys/file.h"
+#include "userprog/syscall.h"
 #include "vm/uninit.h"
+#include "vm/ksm.h"
+#include "vm/text.h"
+#include "intrinsic.h"
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
 
-static struct lock frame_lock;	//frame table lock.
+/* Pages read after a file-backed fault on a page advised MADV_SEQUENTIAL. */
+#define VM_SEQ_AROUND 16
+
+/* Most pages of a file mapping MAP_POPULATE reads at once. */
+#define VM_POPULATE_BATCH 16
+
+struct lock frame_lock;	//frame table lock.
+static struct list_elem *clock_hand;	//next frame the clock looks at, in frame_list.
+static bool victim_busy;	//the last vm_get_victim() found every frame busy. Under frame_lock.
+
+/* -hugepages: back large anonymous regions with 2 MiB frames? */
+bool vm_huge_pages;
+
+/* -spt-hash: keep supplemental page tables in hash tables instead
+ * of radix trees? */
+bool vm_spt_hash;
+
+/* -kswapd-low, -kswapd-high: the reclaim thread wakes up when fewer
+ * than vm_reclaim_low user pages are free, and evicts frames until
+ * vm_reclaim_high are. A low watermark of 0 turns it off. */
+size_t vm_reclaim_low = 16;
+size_t vm_reclaim_high = 32;
+
+/* Shared zero page : a read fault on an anonymous page that has never been
+ * written maps this read-only instead of a frame of its own. The first write
+ * faults again and gets a private frame through vm_handle_wp(). */
+static void *zero_page;
+
+/* -fault-around: off by default, since it makes file-backed memory less lazy
+ * than the lazy loading tests expect. */
+size_t vm_fault_around;
+
+/* -mlock-limit, -mlock-max: pages mlock() may lock in one process, like
+ * RLIMIT_MEMLOCK, and in all, so that locked memory cannot starve everyone
+ * else. The global limit defaults to a quarter of the user pool, and is never
+ * more than half of it. */
+size_t vm_mlock_limit = 256;
+size_t vm_mlock_max = SIZE_MAX;
+static size_t mlocked_cnt;			//pages locked in all.
+static struct lock mlock_lock;		//protects mlocked_cnt and each thread's mlocked_cnt.
+
+static struct semaphore kswapd_sema;	//kswapd sleeps on this.
+static bool kswapd_awake;		//kswapd was woken up and has not gone back to sleep.
+static void kswapd (void *aux);
+
+/* Statistics. */
+static long long huge_map_cnt;		//2 MiB regions mapped with one PDE.
+static long long huge_fallback_cnt;	//eligible regions that fell back to 4 kB pages.
+static long long evict_cnt;		//frames evicted.
+static long long evict_dirty_cnt;	//evicted frames whose contents had to be written out.
+static long long clock_scan_cnt;	//frames the clock hand looked at.
+static long long second_chance_cnt;	//frames passed over because they were accessed.
+static long long madvise_cnt;		//madvise() calls...
+static long long prefetch_cnt;		//...pages they read in for MADV_WILLNEED...
+static long long drop_cnt;			//...and dropped for MADV_DONTNEED.
+static long long drop_behind_cnt;	//MADV_SEQUENTIAL pages evicted despite being accessed.
+static long long mlock_refuse_cnt;	//mlock() calls over the limits.
+static long long mlock_skip_cnt;	//times eviction passed over a locked frame.
+static long long populate_cnt;		//pages loaded by MAP_POPULATE...
+static long long populate_read_cnt;	//...and the file reads that batches of them took.
+static long long fork_cnt;			//address spaces copied by fork...
+static uint64_t fork_cycles;		//...the cycles it took...
+static long long fork_page_cnt;		//...and the pages in them.
+static long long cow_share_cnt;		//pages that shared a frame copy-on-write at fork.
+static long long cow_copy_cnt;		//writes that copied a shared frame...
+static long long cow_reuse_cnt;		//...and that found no one else left to copy it for.
+static long long rmap_promote_cnt;	//shared frames handed over when their own page went away.
+static long long shared_evict_cnt;	//shared frames evicted, unmapped from every sharer.
+static long long zero_map_cnt;		//read faults served by the zero page.
+static long long zero_cow_cnt;		//writes that replaced it with a frame.
+static long long file_fault_cnt;	//faults that loaded a page from a file.
+static long long fault_around_cnt;	//pages loaded along with them.
+static long long exec_cnt;		//programs that reached their first system call...
+static uint64_t exec_cycles;		//...the time it took them...
+static long long exec_fault_cnt;	//...and the page faults on the way.
+static long long kswapd_wake_cnt;	//times kswapd was woken up.
+static long long kswapd_reclaim_cnt;	//frames kswapd gave back to the user pool.
+static uint64_t kswapd_cycles;		//time kswapd spent reclaiming.
+static long long frame_fast_cnt;	//frames taken straight from the user pool.
+static long long frame_direct_cnt;	//frames the faulting thread had to evict itself.
+static uint64_t frame_direct_cycles;	//time spent in those evictions...
+static uint64_t frame_direct_max;	//...and the longest one.
+
+static bool page_equal (const struct hash_elem *e, const void *va, void *aux);
+static void rmap_init (struct frame *frame);
+static bool rmap_add (struct frame *frame, struct page *page, struct thread *owner);
+static bool frame_accessed (struct frame *frame);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -26,6 +123,23 @@ vm_init (void) {
 	/* TODO: Your code goes here. */
 	list_init(&frame_list);
 	lock_init(&frame_lock);
+	zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	ksm_init();
+	text_init();
+	lock_init(&mlock_lock);
+	if(vm_mlock_max == SIZE_MAX){
+		vm_mlock_max = palloc_free_cnt(PAL_USER) / 4;
+	}
+	if(vm_mlock_max > palloc_free_cnt(PAL_USER) / 2){
+		vm_mlock_max = palloc_free_cnt(PAL_USER) / 2;
+	}
+	sema_init(&kswapd_sema, 0);
+	if(vm_reclaim_high < vm_reclaim_low){
+		vm_reclaim_high = vm_reclaim_low;
+	}
+	if(vm_reclaim_low > 0){
+		thread_create("kswapd", PRI_DEFAULT, kswapd, NULL);
+	}
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -46,6 +160,15 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static void kswapd_wake (void);
+static bool page_is_file_backed (struct page *page);
+static bool vm_claim_file_page (struct page *page);
+static void vm_munlock_page (struct page *page);
+static bool vm_handle_cow (struct page *page);
+static void vm_fault_around_pages (struct page *fault);
+static bool huge_region_claimable (struct page *page);
+static bool vm_do_claim_huge (struct page *page);
+static void page_reset_uninit (struct page *p);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -88,11 +211,14 @@ struct page *
 spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
 	struct page *page = NULL;
 	/* TODO: Fill this function. */
-	struct page p;
-	struct hash_elem *e;
-	p.va = va;
-	e = hash_find(&spt->hash, &p.hash_elem);
-	page = (e != NULL ? hash_entry(e, struct page, hash_elem) : NULL);
+	if(vm_spt_hash){
+		struct hash_elem *e;
+		e = hash_lookup(&spt->hash, hash_u64((uint64_t) va), page_equal, va, NULL);
+		page = (e != NULL ? hash_entry(e, struct page, hash_elem) : NULL);
+	}
+	else if(is_user_vaddr(va)){
+		page = radix_lookup(&spt->radix, va);
+	}
 
 	return page;
 }
@@ -103,8 +229,11 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED,
 		struct page *page UNUSED) {
 	bool succ = false;
 	/* TODO: Fill this function. */
-	if(hash_insert(&spt->hash, &page->hash_elem) == NULL){
-		succ = true;
+	if(vm_spt_hash){
+		succ = hash_insert(&spt->hash, &page->hash_elem) == NULL;
+	}
+	else if(is_user_vaddr(page->va)){
+		succ = radix_insert(&spt->radix, page->va, page);
 	}
 
 	return succ;
@@ -112,41 +241,225 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED,
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
-	if(hash_delete (&spt->hash, &page->hash_elem) != NULL){
+	bool removed;
+	if(vm_spt_hash){
+		removed = hash_delete (&spt->hash, &page->hash_elem) != NULL;
+	}
+	else{
+		removed = radix_remove (&spt->radix, page->va) == page;
+	}
+	if(removed){
+		vm_munlock_page(page);
 		vm_dealloc_page (page);
 	}
 }
 
+/* Returns the frame under the clock hand and advances the hand,
+ * wrapping around at the end of the frame table. */
+static struct frame *
+clock_next (void) {
+	if(clock_hand == NULL || clock_hand == list_end(&frame_list)){
+		clock_hand = list_begin(&frame_list);
+	}
+	struct frame *frame = list_entry(clock_hand, struct frame, elem);
+	clock_hand = list_next(clock_hand);
+	return frame;
+}
+
+/* Would evicting FRAME have to write its contents out? File pages only
+ * if any page mapping them modified them; anonymous pages always, since
+ * the swap disk is the only place they can come back from. */
+static bool
+frame_is_dirty (struct frame *frame) {
+	struct list_elem *e;
+	if(VM_TYPE(frame->page->operations->type) != VM_FILE){
+		return true;
+	}
+	for(e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)){
+		struct rmap *r = list_entry(e, struct rmap, elem);
+		if(pml4_is_dirty(r->owner->pml4, r->page->va)){
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Is FRAME mapped by a page that mlock() keeps in memory? Called with
+ * frame_lock held. */
+static bool
+frame_mlocked (struct frame *frame) {
+	struct list_elem *e;
+	for(e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)){
+		if(list_entry(e, struct rmap, elem)->page->mlocked){
+			mlock_skip_cnt++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Does FRAME, just found accessed, go without its second chance? Pages advised
+ * MADV_SEQUENTIAL are read once and left behind : evict them first. */
+static bool
+frame_drop_behind (struct frame *frame) {
+	if(frame->page->advice != MADV_SEQUENTIAL){
+		return false;
+	}
+	drop_behind_cnt++;
+	return true;
+}
+
 /* Get the struct frame, that will be evicted. */
 static struct frame *
 vm_get_victim (void) {
 	struct frame *victim = NULL;
 	 /* TODO: The policy for eviction is up to you. */
-	//policy : FIFO.
-	//lock_acquire(&frame_lock);
-	victim = list_entry(list_pop_front(&frame_list), struct frame, elem);
-	//lock_release(&frame_lock);
+	//policy : clock (second chance), preferring clean frames. Called with frame_lock held.
+	//One revolution clears the accessed bits and takes the first clean frame that was not
+	//accessed, or failing that the first dirty one. If every frame had been accessed, the
+	//second revolution does the same with the bits it cleared.
+	struct frame *dirty = NULL;
+	size_t n = list_size(&frame_list), i;
+	for(i = 0; i < 2 * n && (i < n || dirty == NULL); i++){
+		struct frame *frame = clock_next();
+		if(frame->page == NULL || frame->pinned || frame_mlocked(frame)){	//Still being claimed, copied from, or locked.
+			continue;
+		}
+		clock_scan_cnt++;
+		if(frame_accessed(frame) && !frame_drop_behind(frame)){
+			second_chance_cnt++;
+			continue;
+		}
+		if(!frame_is_dirty(frame)){
+			victim = frame;
+			break;
+		}
+		if(dirty == NULL){
+			dirty = frame;
+		}
+	}
+	if(victim == NULL){
+		victim = dirty;
+	}
+	for(i = 0; victim == NULL && i < n; i++){	//Everything was touched again under us : take the first frame we may.
+		struct frame *frame = clock_next();
+		if(frame->page != NULL && !frame->pinned && !frame_mlocked(frame)){
+			victim = frame;
+		}
+	}
+	victim_busy = victim == NULL;
+	if(victim != NULL){	//NULL : every frame is pinned, locked or still being claimed.
+		vm_unlink_frame(victim);
+	}
 	return victim;
 }
 
+/* Take up to MAX more frames holding private anonymous pages from just ahead of
+ * the clock hand, into FRAMES, so they can go to swap along with the victim. Frames
+ * that were accessed get their second chance as usual. Looks at no more than
+ * 2 * MAX frames. Called with frame_lock held. */
+static size_t
+vm_get_anon_batch (struct frame *frames[], size_t max) {
+	size_t cnt = 0, scanned, n = list_size(&frame_list);
+	for(scanned = 0; cnt < max && scanned < 2 * max && scanned < n; scanned++){
+		struct frame *frame = clock_next();
+		if(frame->page == NULL || VM_TYPE(frame->page->operations->type) != VM_ANON
+				|| frame->map_cnt > 1 || frame->pinned || frame_mlocked(frame)){
+			continue;
+		}
+		clock_scan_cnt++;
+		if(frame_accessed(frame) && !frame_drop_behind(frame)){
+			second_chance_cnt++;
+			continue;
+		}
+		vm_unlink_frame(frame);		//The hand is already past it.
+		frames[cnt++] = frame;
+	}
+	return cnt;
+}
+
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.
+ * An anonymous victim takes up to SWAP_BATCH - 1 other cold anonymous pages to
+ * swap with it in one disk write; their frames go back to the user pool. A victim
+ * shared copy-on-write goes to a slot of its own that all its sharers take a share
+ * of. Every page mapping an evicted frame is unmapped. */
 static struct frame *
 vm_evict_frame (void) {
 	struct frame* victim = vm_get_victim ();
 	/* TODO: swap out the victim and return the evicted frame. */
-	ASSERT(victim != NULL);
-	struct page* victim_page = victim->page;
-	struct thread* victim_owner = victim->owner;
-	if(!swap_out(victim_page)){
-		//printf("swap-out failed at victim page 0x%X\n",victim_page->va);
+	if(victim == NULL){
+		return NULL;
+	}
+	struct frame* batch[SWAP_BATCH];
+	struct page* pages[SWAP_BATCH];
+	size_t cnt = 1, done, i;
+	bool dirty = frame_is_dirty(victim);
+	batch[0] = victim;
+	pages[0] = victim->page;
+	if(VM_TYPE(victim->page->operations->type) == VM_ANON && victim->map_cnt > 1){
+		struct list_elem *e;
+		done = anon_swap_out_shared(pages[0]) ? 1 : 0;
+		for(e = list_begin(&victim->rmap); done && e != list_end(&victim->rmap); e = list_next(e)){
+			struct rmap *r = list_entry(e, struct rmap, elem);
+			if(r->page != pages[0]){
+				anon_share_slot(r->page, pages[0]);
+			}
+		}
+		shared_evict_cnt += done;
+	}
+	else if(VM_TYPE(victim->page->operations->type) == VM_ANON){
+		cnt += vm_get_anon_batch(batch + 1, SWAP_BATCH - 1);
+		for(i = 1; i < cnt; i++){
+			pages[i] = batch[i]->page;
+		}
+		done = anon_swap_out_batch(pages, cnt);
+	}
+	else{
+		if(dirty){	//Perhaps by a page sharing it : the write-back goes by the frame's own page.
+			pml4_set_dirty(victim->owner->pml4, pages[0]->va, true);
+		}
+		done = swap_out(pages[0]) ? 1 : 0;
+	}
+	for(i = done; i < cnt; i++){	//Still in use : back on the clock.
+		list_push_back(&frame_list, &batch[i]->elem);
+	}
+	if(done == 0){
+		//printf("swap-out failed at victim page 0x%X\n",pages[0]->va);
 		return NULL;
 	}
-	//USE : void pml4_clear_page (uint64_t *pml4, void *upage)
-	pml4_clear_page(victim_owner->pml4, victim_page->va);
+	for(i = 0; i < done; i++){
+		vm_rmap_clear(batch[i], true);
+		if(i > 0){
+			palloc_free_page(batch[i]->kva);
+			free(batch[i]);
+		}
+	}
+	evict_cnt += done;
+	if(dirty){
+		evict_dirty_cnt += done;
+	}
 	return victim;
 }
 
+/* Put user page KVA in a new frame and add it to the frame table. */
+static struct frame *
+vm_new_frame (void *kva) {
+	struct frame *frame = malloc(sizeof(struct frame));
+	if(frame != NULL){
+		frame->kva = kva;
+		frame->page = NULL;
+		frame->owner = thread_current();
+		frame->ksm_sum = 0;
+		frame->ksm_candidate = false;
+		rmap_init(frame);
+		lock_acquire(&frame_lock);
+		list_push_back(&frame_list, &frame->elem);
+		lock_release(&frame_lock);
+	}
+	return frame;
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
@@ -156,38 +469,126 @@ vm_get_frame (void) {
 	struct frame *frame = NULL;
 	/* TODO: Fill this function. */
 	void* new = palloc_get_page(PAL_USER);	//get a page from the user pool. NULL if allocation fails.
-	lock_acquire(&frame_lock);
+	while(new == NULL && (anon_swap_cache_shrink() || text_reclaim())){	//Drop read-ahead pages and cold text first : they are still on disk.
+		new = palloc_get_page(PAL_USER);
+	}
+	if(palloc_free_cnt(PAL_USER) < vm_reclaim_low){	//Running low : have kswapd refill the pool.
+		kswapd_wake();
+	}
 	if(new != NULL){
-		//initialize frame.
-		frame = malloc(sizeof(struct frame));
-		if(frame != NULL){
-			frame->kva = new;
-			frame->page = NULL;
-			frame->owner = thread_current();
-			list_push_back(&frame_list, &frame->elem);
-		}
+		frame = vm_new_frame(new);
+		frame_fast_cnt++;
 	}
 	else{	//Evict a frame and retrieve it. Use the page @ frame->kva.
-		frame = vm_evict_frame();
+		uint64_t start = rdtsc(), cycles;
+		lock_acquire(&frame_lock);
+		for(;;){
+			frame = vm_evict_frame();
+			if(frame != NULL || !victim_busy){
+				break;
+			}
+			//Nothing may be evicted right now : let the owners of the busy frames go on, then try again.
+			lock_release(&frame_lock);
+			thread_yield();
+			new = palloc_get_page(PAL_USER);
+			lock_acquire(&frame_lock);
+			if(new != NULL){
+				break;
+			}
+		}
 		if(frame != NULL){
 			frame->page = NULL;
 			frame->owner = thread_current();
 			list_push_back(&frame_list, &frame->elem);
 		}
+		lock_release(&frame_lock);
+		if(new != NULL){	//Freed while we waited.
+			frame = vm_new_frame(new);
+		}
+		cycles = rdtsc() - start;
+		frame_direct_cnt++;
+		frame_direct_cycles += cycles;
+		if(cycles > frame_direct_max){
+			frame_direct_max = cycles;
+		}
 	}
-	lock_release(&frame_lock);
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Wakes kswapd up, unless it is already awake or turned off. */
+static void
+kswapd_wake (void) {
+	if(vm_reclaim_low > 0 && !kswapd_awake){
+		kswapd_awake = true;
+		sema_up(&kswapd_sema);
+	}
+}
+
+/* Background reclaim thread. Each time it is woken up, evicts frames the same
+ * way a fault would, anonymous pages to swap and dirty file pages back to their
+ * files, until vm_reclaim_high user pages are free, so that faults find a free
+ * frame without waiting for the disk. Read-ahead pages in the swap cache go
+ * first. Gives up early if nothing can be evicted. */
+static void
+kswapd (void *aux UNUSED) {
+	for(;;){
+		sema_down(&kswapd_sema);
+		uint64_t start = rdtsc();
+		kswapd_wake_cnt++;
+		while(palloc_free_cnt(PAL_USER) < vm_reclaim_high){
+			struct frame *frame = NULL;
+			if(anon_swap_cache_shrink() || text_reclaim()){
+				continue;
+			}
+			lock_acquire(&frame_lock);
+			if(!list_empty(&frame_list)){
+				frame = vm_evict_frame();
+			}
+			lock_release(&frame_lock);
+			if(frame == NULL){	//Swap disk full, or nothing left to evict.
+				break;
+			}
+			palloc_free_page(frame->kva);
+			free(frame);
+			kswapd_reclaim_cnt++;
+		}
+		kswapd_cycles += rdtsc() - start;
+		kswapd_awake = false;
+	}
+}
+
+/* Would PAGE read as all zeros if it were claimed now? True for anonymous pages
+ * that were never loaded and have nothing to load from a file : new stack pages
+ * and the bss. */
 static bool
-vm_stack_growth (void *addr UNUSED) {
+page_is_zero_fill (struct page *page) {
+	struct lazy_aux *aux = page->uninit.aux;
+	return VM_TYPE(page->operations->type) == VM_UNINIT
+		&& VM_TYPE(page->uninit.type) == VM_ANON
+		&& page->frame == NULL
+		&& (aux == NULL || aux->page_read_bytes == 0);
+}
+
+/* Map the shared zero page read-only at PAGE, which must be zero-fill. */
+static bool
+vm_map_zero_page (struct page *page) {
+	if(!pml4_set_page(thread_current()->pml4, page->va, zero_page, false)){
+		return false;
+	}
+	zero_map_cnt++;
+	return true;
+}
+
+/* Growing the stack. A read gets the zero page. */
+static bool
+vm_stack_growth (void *addr UNUSED, bool write) {
 	bool success;
 	success = vm_alloc_page(VM_MARKER_0 + VM_ANON, pg_round_down(addr), true);
 	if(success){
-		success = vm_claim_page(pg_round_down(addr));
+		success = write ? vm_claim_page(pg_round_down(addr))
+			: vm_map_zero_page(spt_find_page(&thread_current()->spt, pg_round_down(addr)));
 	}
 	return success;
 }
@@ -198,6 +599,21 @@ vm_handle_wp (struct page *page UNUSED) {
 	if(!page->writable){	//Check if write-protected page.
 		return false;
 	}
+	else if(VM_TYPE(page->operations->type) == VM_ANON && page->anon.ksm != NULL){	//Merged : a private copy.
+		return ksm_unmerge(page);
+	}
+	else if(pml4_get_page(thread_current()->pml4, page->va) == zero_page){	//First write : a frame of its own.
+		bool zero = page->uninit.init == NULL;	//Nothing will fill it in.
+		pml4_clear_page(thread_current()->pml4, page->va);
+		if(!vm_do_claim_page(page)){
+			return false;
+		}
+		if(zero){
+			memset(page->frame->kva, 0, PGSIZE);
+		}
+		zero_cow_cnt++;
+		return true;
+	}
 	else if(page_get_type(page) == VM_FILE){	//File mapped pages should share physical page.
 		void* KVA = pml4_get_page(thread_current()->pml4, page->va);
 		pml4_clear_page(thread_current()->pml4, page->va);
@@ -205,20 +621,58 @@ vm_handle_wp (struct page *page UNUSED) {
 		return true;
 	}
 	else{				//Writable is TRUE, so this is a COPY-ON-WRITE!!
-		//printf("COW fault @ thread %d, PAGE 0x%X, writable : %d, \n", thread_current()->tid, page->va, page->writable);
-		if(page->frame != NULL){
-			vm_dealloc_frame(page->frame);
-		}
-		void* old_kva = pml4_get_page(thread_current()->pml4, page->va);
-		pml4_clear_page(thread_current()->pml4, page->va);	//Remove mapping.
-		if(!vm_do_claim_page(page)){
-			return false;
-		}
-		ASSERT(page->frame != NULL);
-		memcpy(page->frame->kva, old_kva, PGSIZE);		//Copy contents. What about file-mapped pages??
+		return vm_handle_cow(page);
+	}
+}
+
+/* Copy-on-write : PAGE, writable, shares a frame read-only since a fork. If
+ * everyone else has copied the frame or gone, PAGE just takes it back writable.
+ * Otherwise PAGE gets a copy in a frame of its own, and leaves the old one to
+ * the others. */
+static bool
+vm_handle_cow (struct page *page) {
+	struct thread *curr = thread_current();
+	struct frame *old, *frame;
+	void *kva;
+	lock_acquire(&frame_lock);
+	if(page->rmap == NULL){		//Evicted under us : the fault will come back not present.
+		lock_release(&frame_lock);
 		return true;
 	}
-	
+	old = page->rmap->frame;
+	if(old->map_cnt == 1){
+		ASSERT(old->page == page);
+		lock_release(&frame_lock);
+		pml4_clear_page(curr->pml4, page->va);
+		pml4_set_page(curr->pml4, page->va, old->kva, true);
+		cow_reuse_cnt++;
+		return true;
+	}
+	old->pinned = true;
+	lock_release(&frame_lock);
+
+	frame = vm_get_frame();
+	memcpy(frame->kva, old->kva, PGSIZE);
+	vm_rmap_remove(page);
+	lock_acquire(&frame_lock);
+	old->pinned = false;
+	lock_release(&frame_lock);
+	if(page->frame == old){		//The others went away while we copied.
+		kva = old->kva;
+		pml4_clear_page(curr->pml4, page->va);
+		vm_dealloc_frame(old);
+		palloc_free_page(kva);
+	}
+	if(VM_TYPE(page->operations->type) == VM_UNINIT){	//Copied : nothing left to load.
+		page->uninit.page_initializer(page, page->uninit.type, frame->kva);
+	}
+	rmap_add(frame, page, curr);
+	frame->page = page;
+	page->frame = frame;
+	pml4_set_page(curr->pml4, page->va, frame->kva, true);
+	pml4_set_accessed(curr->pml4, page->va, true);
+	cow_copy_cnt++;
+	return true;
 }
 
 /* Return true on success */
@@ -229,12 +683,13 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	struct page *page = NULL;
 	bool accessing_stack;
 	bool success;
+	thread_current()->exec_faults++;
 	/* TODO: Validate the fault */
 	page = spt_find_page(spt, pg_round_down(addr));
 	if(page == NULL){	//the page is INVALID.
 		accessing_stack = ((addr < USER_STACK) && (USER_STACK - (int) pg_round_down(addr)) <= (PGSIZE << 8) && (uintptr_t)addr >= (f->rsp - 64));
 		if(accessing_stack){	//Stack Growth.
-			return vm_stack_growth(addr);
+			return vm_stack_growth(addr, write);
 		}
 		else{		//Not a stack-access, so its a real fault.
 			return false;
@@ -244,10 +699,477 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	if(write && !not_present){
 		return vm_handle_wp(page);
 	}
+	if(vm_huge_pages && huge_region_claimable(page)){
+		return vm_do_claim_huge(page);
+	}
+	if(!write && page_is_zero_fill(page)){	//Read of untouched memory : share the zero page.
+		return vm_map_zero_page(page);
+	}
+	if(page_is_file_backed(page)){
+		struct page around = *page;	//Claiming changes the union : keep the lazy_aux run.
+		file_fault_cnt++;
+		if(!vm_claim_file_page(page)){
+			return false;
+		}
+		if(page->advice == MADV_SEQUENTIAL || (vm_fault_around > 1 && page->advice != MADV_RANDOM)){
+			vm_fault_around_pages(&around);
+		}
+		return true;
+	}
 
 	return vm_do_claim_page (page);
 }
 
+/* Is PAGE still to be loaded from a file : an executable segment or a mapping? */
+static bool
+page_is_file_backed (struct page *page) {
+	struct lazy_aux *aux = page->uninit.aux;
+	return VM_TYPE(page->operations->type) == VM_UNINIT
+		&& page->frame == NULL
+		&& aux != NULL && aux->executable != NULL && aux->page_read_bytes > 0;
+}
+
+/* Load PAGE, which is file-backed : read-only executable text through the
+ * text cache when it is shared, anything else into a frame of its own. */
+static bool
+vm_claim_file_page (struct page *page) {
+	if(vm_share_text && !page->writable && VM_TYPE(page->uninit.type) == VM_ANON){
+		return text_map(page);
+	}
+	return vm_do_claim_page(page);
+}
+
+/* Fault-around. Having loaded the page that FAULT was a copy of before it was
+ * claimed, load the other pages of the vm_fault_around-page aligned window
+ * around it that come from the same run of the same file : same initializer,
+ * same inode, file offsets that follow the addresses. Each is one disk transfer,
+ * to sectors next to the ones just read. Pages that are already mapped are left
+ * alone, and so is everything once free user memory runs low, since reading
+ * ahead is not worth evicting for. The pages are mapped as not accessed, so the
+ * clock takes them first if they turn out to be unused. Pages advised
+ * MADV_SEQUENTIAL read the VM_SEQ_AROUND pages after FAULT instead. */
+static void
+vm_fault_around_pages (struct page *fault) {
+	struct thread *curr = thread_current();
+	struct lazy_aux *aux = fault->uninit.aux;
+	struct inode *inode = file_get_inode(aux->executable);
+	size_t n, i;
+	uint8_t *base;
+	if(fault->advice == MADV_SEQUENTIAL){	//Even without -fault-around, so vm_fault_around may be 0.
+		n = VM_SEQ_AROUND;
+		base = fault->va;
+	}
+	else if(vm_fault_around > 1){
+		n = vm_fault_around;
+		base = (uint8_t *) fault->va - ((uint64_t) fault->va >> PGBITS) % n * PGSIZE;
+	}
+	else{
+		return;
+	}
+
+	for(i = 0; i < n; i++){
+		uint8_t *va = base + i * PGSIZE;
+		struct page *p;
+		struct lazy_aux *p_aux;
+		if(va == fault->va || !is_user_vaddr(va)){
+			continue;
+		}
+		if(palloc_free_cnt(PAL_USER) <= vm_reclaim_low){
+			break;
+		}
+		p = spt_find_page(&curr->spt, va);
+		if(p == NULL || !page_is_file_backed(p) || p->uninit.init != fault->uninit.init
+				|| p->advice == MADV_RANDOM || pml4_get_page(curr->pml4, va) != NULL){
+			continue;
+		}
+		p_aux = p->uninit.aux;
+		if(file_get_inode(p_aux->executable) != inode
+				|| p_aux->offset - aux->offset != va - (uint8_t *) fault->va){
+			continue;
+		}
+		if(!vm_claim_file_page(p)){
+			break;
+		}
+		pml4_set_accessed(curr->pml4, va, false);
+		fault_around_cnt++;
+	}
+}
+
+/* Start timing the current process from exec to its first system call. */
+void
+vm_exec_begin (void) {
+	struct thread *curr = thread_current();
+	curr->exec_faults = 0;
+	curr->exec_tsc = rdtsc();
+}
+
+/* The current process made its first system call since exec : account for it. */
+void
+vm_exec_end (void) {
+	struct thread *curr = thread_current();
+	exec_cycles += rdtsc() - curr->exec_tsc;
+	exec_fault_cnt += curr->exec_faults;
+	exec_cnt++;
+	curr->exec_tsc = 0;
+}
+
+/* Initializer for anonymous pages that must read as zeros even when the first
+ * access is a write, like pages whose contents were dropped and anonymous
+ * mappings. */
+bool
+vm_zero_fill (struct page *page, void *aux UNUSED) {
+	memset(page->frame->kva, 0, PGSIZE);
+	return true;
+}
+
+/* MADV_WILLNEED : read PAGE in now if its contents are on disk, in a file or in
+ * swap, and map it as not accessed, like fault-around does. Only spare memory
+ * is used. Returns false once free user memory runs low. */
+static bool
+vm_prefetch_page (struct page *page) {
+	struct thread *curr = thread_current();
+	bool swapped = false;
+	if(palloc_free_cnt(PAL_USER) <= vm_reclaim_low){
+		return false;
+	}
+	if(page->frame != NULL || pml4_get_page(curr->pml4, page->va) != NULL){	//Already in.
+		return true;
+	}
+	switch(VM_TYPE(page->operations->type)){
+		case VM_ANON :
+			swapped = page->anon.slot != NO_SLOT || page->anon.zswap != NULL || page->anon.cache != NULL;
+			break;
+		case VM_FILE :
+			swapped = true;
+			break;
+		default :
+			break;
+	}
+	if(page_is_file_backed(page)){
+		if(!vm_claim_file_page(page)){
+			return false;
+		}
+	}
+	else if(swapped){
+		if(!vm_do_claim_page(page)){
+			return false;
+		}
+	}
+	else{		//Zero-filled on demand : nothing to read.
+		return true;
+	}
+	pml4_set_accessed(curr->pml4, page->va, false);
+	prefetch_cnt++;
+	return true;
+}
+
+/* MADV_DONTNEED : drop PAGE's contents, giving its frame back to the user pool
+ * and its swap slot back to the swap disk. It is made again as it was before
+ * its first fault, so the next access reads it from its file, or gets zeros.
+ * A dirty file mapping is written back first. Returns false if memory runs
+ * out. */
+static bool
+vm_drop_page (struct page *page) {
+	struct thread *curr = thread_current();
+	void *va = page->va;
+	vm_initializer *init = page->uninit.init;
+	enum vm_type type = page->uninit.type;
+	bool writable = page->writable;
+	uint8_t advice = page->advice;
+	struct lazy_aux *aux;
+	ASSERT(!page->mlocked);
+	if(VM_TYPE(page->operations->type) == VM_UNINIT && pml4_get_page(curr->pml4, va) == NULL){
+		return true;		//Never loaded : nothing to drop.
+	}
+	aux = lazy_aux_get(page->uninit.aux);	//The new page takes it over.
+	vm_unmap_page(page);
+	if(init == NULL && VM_TYPE(type) == VM_ANON){
+		init = vm_zero_fill;
+	}
+	if(!vm_alloc_page_with_initializer(type, va, writable, init, aux)){
+		lazy_aux_put(aux);
+		return false;
+	}
+	spt_find_page(&curr->spt, va)->advice = advice;
+	drop_cnt++;
+	return true;
+}
+
+/* madvise : advise the VM on the use of the LENGTH bytes at ADDR, which must be
+ * page aligned and all mapped. MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL are
+ * kept in the pages for fault-around, swap readahead and eviction to follow.
+ * MADV_WILLNEED and MADV_DONTNEED act on the pages at once. Returns 0, or -1 if
+ * the arguments are bad, or if MADV_DONTNEED is given pages locked by mlock(). */
+int
+vm_madvise (void *addr, size_t length, int advice) {
+	struct thread *curr = thread_current();
+	uint8_t *start = addr, *end = start + ROUND_UP(length, PGSIZE), *va;
+	bool ok = true;
+	if(pg_ofs(addr) != 0 || length == 0 || end <= start || !is_user_vaddr(end - 1)
+			|| advice < MADV_NORMAL || advice > MADV_DONTNEED){
+		return -1;
+	}
+	for(va = start; va < end; va += PGSIZE){
+		struct page *page = spt_find_page(&curr->spt, va);
+		if(page == NULL || (advice == MADV_DONTNEED && page->mlocked)){
+			return -1;
+		}
+	}
+	madvise_cnt++;
+	if(advice == MADV_DONTNEED){
+		lock_acquire(&filesys_lock);	//Dirty file mappings are written back.
+	}
+	for(va = start; ok && va < end; va += PGSIZE){
+		struct page *page = spt_find_page(&curr->spt, va);
+		switch(advice){
+			case MADV_WILLNEED :
+				ok = vm_prefetch_page(page);	//Stops, but does not fail, when memory is short.
+				break;
+			case MADV_DONTNEED :
+				ok = vm_drop_page(page);
+				break;
+			default :
+				page->advice = advice;
+				break;
+		}
+	}
+	if(advice == MADV_DONTNEED){
+		lock_release(&filesys_lock);
+	}
+	return ok || advice == MADV_WILLNEED ? 0 : -1;
+}
+
+/* Check that the pages from ADDR for LENGTH bytes are all mapped, and return
+ * the first in *START and the end of the last in *END. */
+static bool
+mlock_range (const void *addr, size_t length, uint8_t **start, uint8_t **end) {
+	struct thread *curr = thread_current();
+	uint8_t *va;
+	*start = pg_round_down(addr);
+	*end = (uint8_t *) ROUND_UP((uint64_t) addr + length, PGSIZE);
+	if(length == 0 || *end <= *start || !is_user_vaddr(*end - 1)){
+		return false;
+	}
+	for(va = *start; va < *end; va += PGSIZE){
+		if(spt_find_page(&curr->spt, va) == NULL){
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Take CNT pages off the current process's and the global locked counts. */
+static void
+mlock_uncharge (size_t cnt) {
+	lock_acquire(&mlock_lock);
+	thread_current()->mlocked_cnt -= cnt;
+	mlocked_cnt -= cnt;
+	lock_release(&mlock_lock);
+}
+
+/* mlock : load the pages from ADDR for LENGTH bytes, which must all be mapped,
+ * and keep them in memory until munlock() : eviction passes their frames by,
+ * and so does text reclaim. Pages are locked before they are loaded, so a page
+ * cannot be evicted between the two. Writing to a locked page shared
+ * copy-on-write gives it a frame of its own, locked in turn. Returns 0, or -1
+ * if the arguments are bad, the pages would go over vm_mlock_limit for the
+ * process or vm_mlock_max in all, or memory runs out, in which case the pages
+ * loaded so far stay locked. */
+int
+vm_mlock (const void *addr, size_t length) {
+	struct thread *curr = thread_current();
+	uint8_t *start, *end, *va;
+	size_t cnt = 0, done = 0;
+	if(!mlock_range(addr, length, &start, &end)){
+		return -1;
+	}
+	for(va = start; va < end; va += PGSIZE){
+		cnt += !spt_find_page(&curr->spt, va)->mlocked;
+	}
+	lock_acquire(&mlock_lock);
+	if(curr->mlocked_cnt + cnt > vm_mlock_limit || mlocked_cnt + cnt > vm_mlock_max){
+		mlock_refuse_cnt++;
+		lock_release(&mlock_lock);
+		return -1;
+	}
+	curr->mlocked_cnt += cnt;		//Charge them all up front.
+	mlocked_cnt += cnt;
+	lock_release(&mlock_lock);
+	for(va = start; va < end; va += PGSIZE){
+		struct page *page = spt_find_page(&curr->spt, va);
+		bool ok = true;
+		if(page->mlocked){
+			continue;
+		}
+		page->mlocked = true;
+		done++;
+		if(pml4_get_page(curr->pml4, va) == NULL){
+			ok = page_is_file_backed(page) ? vm_claim_file_page(page) : vm_do_claim_page(page);
+		}
+		if(!ok){
+			page->mlocked = false;
+			mlock_uncharge(cnt - done + 1);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* munlock : let the pages from ADDR for LENGTH bytes, which must all be mapped,
+ * be evicted again. Returns 0, or -1 if the arguments are bad. */
+int
+vm_munlock (const void *addr, size_t length) {
+	struct thread *curr = thread_current();
+	uint8_t *start, *end, *va;
+	size_t cnt = 0;
+	if(!mlock_range(addr, length, &start, &end)){
+		return -1;
+	}
+	for(va = start; va < end; va += PGSIZE){
+		struct page *page = spt_find_page(&curr->spt, va);
+		cnt += page->mlocked;
+		page->mlocked = false;
+	}
+	mlock_uncharge(cnt);
+	return 0;
+}
+
+/* PAGE, of the current process, is going away : unlock it. */
+static void
+vm_munlock_page (struct page *page) {
+	if(page->mlocked){
+		page->mlocked = false;
+		mlock_uncharge(1);
+	}
+}
+
+/* Remove PAGE from the current thread's spt and destroy it. Also unmap it, and
+ * give back the frame it had to itself, which destroy() leaves mapped for
+ * pml4_destroy() to free at exit. A 2 MiB mapping is split first. */
+void
+vm_unmap_page (struct page *page) {
+	struct thread *curr = thread_current();
+	void *va = page->va, *kva;
+	spt_remove_page(&curr->spt, page);
+	kva = pml4_get_page(curr->pml4, va);
+	if(kva != NULL){
+		pml4_clear_page(curr->pml4, va);
+		palloc_free_page(kva);
+	}
+}
+
+/* Claim PAGE, a page of a file mapping that was never loaded, whose contents
+ * were read already : the BYTES at SRC, then zeros. Like vm_do_claim_page(),
+ * without the read. The frame is only published once it is filled. */
+static bool
+vm_claim_mapped_page (struct page *page, const void *src, size_t bytes) {
+	struct thread *curr = thread_current();
+	struct frame *frame = vm_get_frame();
+	rmap_add(frame, page, curr);
+	page->frame = frame;
+	if(!page->uninit.page_initializer(page, page->uninit.type, frame->kva)){
+		return false;
+	}
+	memcpy(frame->kva, src, bytes);
+	memset((uint8_t *) frame->kva + bytes, 0, PGSIZE - bytes);
+	page->file.read_bytes = bytes;
+	pml4_set_page(curr->pml4, page->va, frame->kva, page->writable);
+	pml4_set_accessed(curr->pml4, page->va, true);
+	frame->page = page;
+	return true;
+}
+
+/* MAP_POPULATE : load the run of up to VM_POPULATE_BATCH pages of a file
+ * mapping from FIRST, which is file-backed and not loaded, up to END. The run
+ * covers consecutive bytes of the file, so it is read with one file_read_at()
+ * into BUF, which the inode layer turns into one disk request per stretch of
+ * contiguous sectors, and then copied into the frames. Returns the pages
+ * loaded, 0 on failure. */
+static size_t
+vm_populate_file_run (struct page *first, uint8_t *end, uint8_t *buf) {
+	struct thread *curr = thread_current();
+	struct lazy_aux *aux = first->uninit.aux;
+	struct inode *inode = file_get_inode(aux->executable);
+	struct page *run[VM_POPULATE_BATCH];
+	uint8_t *va = first->va;
+	size_t n = 0, bytes = 0, i;
+	//1. Gather the run.
+	while(n < VM_POPULATE_BATCH && va < end){
+		struct page *p = spt_find_page(&curr->spt, va);
+		struct lazy_aux *p_aux;
+		if(p == NULL || !page_is_file_backed(p) || VM_TYPE(p->uninit.type) != VM_FILE
+				|| pml4_get_page(curr->pml4, va) != NULL){
+			break;
+		}
+		p_aux = p->uninit.aux;
+		if(file_get_inode(p_aux->executable) != inode || p_aux->offset != aux->offset + (off_t) bytes){
+			break;
+		}
+		run[n++] = p;
+		bytes += p_aux->page_read_bytes;
+		va += PGSIZE;
+		if(p_aux->page_read_bytes < PGSIZE){	//End of the file.
+			break;
+		}
+	}
+	//2. Read it at once.
+	if(file_read_at(aux->executable, buf, bytes, aux->offset) != (off_t) bytes){
+		return 0;
+	}
+	populate_read_cnt++;
+	//3. Give each page a frame.
+	for(i = 0; i < n; i++){
+		struct lazy_aux *p_aux = run[i]->uninit.aux;
+		if(!vm_claim_mapped_page(run[i], buf + i * PGSIZE, p_aux->page_read_bytes)){
+			break;
+		}
+	}
+	populate_cnt += i;
+	return i;
+}
+
+/* MAP_POPULATE : load every page of the mapping mmap() just made from ADDR for
+ * LENGTH bytes, so that using them takes no faults. File pages go in batches
+ * through vm_populate_file_run(), anonymous pages get frames of their own, a
+ * 2 MiB one at a time where huge pages allow. Stops at the first failure,
+ * leaving the rest to be loaded lazily. */
+void
+vm_populate (void *addr, size_t length) {
+	struct thread *curr = thread_current();
+	uint8_t *va = addr, *end = va + ROUND_UP(length, PGSIZE);
+	uint8_t *buf = palloc_get_multiple(0, VM_POPULATE_BATCH);
+	while(va < end){
+		struct page *page = spt_find_page(&curr->spt, va);
+		size_t n = 1;
+		bool ok = true;
+		if(page == NULL){	//A file mapping ends with the file.
+			break;
+		}
+		if(pml4_get_page(curr->pml4, va) != NULL){
+			//Already loaded : with the rest of its huge page, say.
+		}
+		else if(buf != NULL && page_is_file_backed(page) && VM_TYPE(page->uninit.type) == VM_FILE){
+			n = vm_populate_file_run(page, end, buf);
+			ok = n > 0;
+		}
+		else if(vm_huge_pages && huge_region_claimable(page)){
+			ok = vm_do_claim_huge(page);
+			populate_cnt += ok;
+		}
+		else{
+			ok = page_is_file_backed(page) ? vm_claim_file_page(page) : vm_do_claim_page(page);
+			populate_cnt += ok;
+		}
+		if(!ok){
+			break;
+		}
+		va += n * PGSIZE;
+	}
+	if(buf != NULL){
+		palloc_free_multiple(buf, VM_POPULATE_BATCH);
+	}
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void
@@ -259,10 +1181,230 @@ vm_dealloc_page (struct page *page) {
 /* Free the frame struct & remove it from frame table. */
 void
 vm_dealloc_frame (struct frame* frame){
-	list_remove(&frame->elem);
+	lock_acquire(&frame_lock);
+	vm_unlink_frame(frame);
+	lock_release(&frame_lock);
 	free(frame);
 }
 
+/* Get a user page outside the frame table, evicting a frame for it if need be,
+ * for memory the VM keeps track of itself. */
+void *
+vm_get_user_page (void) {
+	struct frame *frame = vm_get_frame();
+	void *kva = frame->kva;
+	vm_dealloc_frame(frame);
+	return kva;
+}
+
+/* Remove FRAME from the frame table, moving the clock hand and the same-page
+ * scanner off it. Called with frame_lock held. */
+void
+vm_unlink_frame (struct frame* frame){
+	if(clock_hand == &frame->elem){
+		clock_hand = list_next(clock_hand);
+	}
+	ksm_frame_unlinked(frame);
+	list_remove(&frame->elem);
+}
+
+/* Reverse map.
+ * Every page that maps a frame is on the frame's rmap list : the frame's own page,
+ * and after a fork the uninit copies that share it read-only until one of them
+ * writes to it. Eviction, accessed and dirty bit sampling and copy-on-write go
+ * through the list to reach every mapping. All rmap lists are protected by
+ * frame_lock. */
+
+/* Start FRAME with no pages mapping it. */
+static void
+rmap_init (struct frame *frame) {
+	list_init(&frame->rmap);
+	frame->map_cnt = 0;
+	frame->map.page = NULL;
+	frame->pinned = false;
+}
+
+/* Put R on FRAME's reverse map, for PAGE of thread OWNER. Called with frame_lock held. */
+static void
+rmap_link (struct frame *frame, struct rmap *r, struct page *page, struct thread *owner) {
+	r->frame = frame;
+	r->page = page;
+	r->owner = owner;
+	list_push_back(&frame->rmap, &r->elem);
+	frame->map_cnt++;
+	page->rmap = r;
+}
+
+/* Add PAGE of thread OWNER to FRAME's reverse map. The first page of a frame
+ * uses the entry built into it, so this only fails, for lack of memory, when
+ * the frame is shared. */
+static bool
+rmap_add (struct frame *frame, struct page *page, struct thread *owner) {
+	struct rmap *r;
+	lock_acquire(&frame_lock);
+	r = frame->map.page == NULL ? &frame->map : malloc(sizeof *r);
+	if(r != NULL){
+		rmap_link(frame, r, page, owner);
+	}
+	lock_release(&frame_lock);
+	return r != NULL;
+}
+
+/* Free R, which is off its list. Called with frame_lock held. */
+static void
+rmap_free (struct rmap *r) {
+	r->page->rmap = NULL;
+	if(r == &r->frame->map){
+		r->page = NULL;
+	}
+	else{
+		free(r);
+	}
+}
+
+/* Empty FRAME's reverse map, clearing every mapping of it if UNMAP. Called with
+ * frame_lock held. */
+void
+vm_rmap_clear (struct frame *frame, bool unmap) {
+	while(!list_empty(&frame->rmap)){
+		struct rmap *r = list_entry(list_pop_front(&frame->rmap), struct rmap, elem);
+		if(unmap){
+			pml4_clear_page(r->owner->pml4, r->page->va);
+		}
+		rmap_free(r);
+	}
+	frame->map_cnt = 0;
+}
+
+/* Has any page mapping FRAME been accessed since the last look? Clears the
+ * accessed bits. Called with frame_lock held. */
+static bool
+frame_accessed (struct frame *frame) {
+	struct list_elem *e;
+	bool accessed = false;
+	for(e = list_begin(&frame->rmap); e != list_end(&frame->rmap); e = list_next(e)){
+		struct rmap *r = list_entry(e, struct rmap, elem);
+		if(pml4_is_accessed(r->owner->pml4, r->page->va)){
+			pml4_set_accessed(r->owner->pml4, r->page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Hand FRAME, whose own page is leaving, over to the first page still mapping
+ * it, an uninit page until now. Its contents are already in the frame, so it is
+ * initialized without loading anything. DIRTY carries the dirty bit of the page
+ * that left over. Called with frame_lock held. */
+static void
+rmap_promote (struct frame *frame, bool dirty) {
+	struct rmap *r = list_entry(list_front(&frame->rmap), struct rmap, elem);
+	struct page *page = r->page;
+	enum intr_level old_level = intr_disable();	//Its owner must not see it half done.
+	if(VM_TYPE(page->operations->type) == VM_UNINIT){
+		page->uninit.page_initializer(page, page->uninit.type, frame->kva);
+		if(VM_TYPE(page->operations->type) == VM_FILE){
+			page->file.read_bytes = page->file.aux->page_read_bytes;
+		}
+	}
+	page->frame = frame;
+	frame->page = page;
+	frame->owner = r->owner;
+	intr_set_level(old_level);
+	if(dirty){
+		pml4_set_dirty(r->owner->pml4, page->va, true);
+	}
+	rmap_promote_cnt++;
+}
+
+/* Take PAGE, of the current thread, out of the reverse map of the frame it maps,
+ * if any, when it is destroyed or copied on write. If others still map the frame,
+ * PAGE is unmapped, and if it was the frame's own page it gives the frame up to
+ * one of them, so that neither destroying PAGE nor its page table frees it. The
+ * last page keeps its mapping and frame for the caller to free. */
+void
+vm_rmap_remove (struct page *page) {
+	struct rmap *r;
+	struct frame *frame;
+	lock_acquire(&frame_lock);
+	r = page->rmap;
+	if(r != NULL){
+		frame = r->frame;
+		list_remove(&r->elem);
+		frame->map_cnt--;
+		if(frame->map_cnt > 0){
+			bool dirty = pml4_is_dirty(r->owner->pml4, page->va);
+			pml4_clear_page(r->owner->pml4, page->va);
+			if(frame->page == page){
+				rmap_promote(frame, dirty);
+				page->frame = NULL;
+			}
+		}
+		rmap_free(r);
+	}
+	lock_release(&frame_lock);
+}
+
+/* Make DST, the current thread's copy of SRC made by fork, share the frame SRC
+ * maps : DST is mapped read-only, and copied on the first write. SRC is write
+ * protected along with the rest of the parent once the copy is done. If SRC was
+ * evicted meanwhile, DST gets its swapped out contents instead. */
+static bool
+rmap_share (struct page *dst, struct page *src) {
+	struct thread *curr = thread_current();
+	struct rmap *r = malloc(sizeof *r);
+	struct frame *frame;
+	if(r == NULL){
+		return false;
+	}
+	lock_acquire(&frame_lock);
+	if(src->rmap == NULL){
+		lock_release(&frame_lock);
+		free(r);
+		return VM_TYPE(src->operations->type) == VM_ANON ? anon_fork_swapped(dst, src) : true;
+	}
+	frame = src->rmap->frame;
+	if(!pml4_set_page(curr->pml4, dst->va, frame->kva, false)){
+		lock_release(&frame_lock);
+		free(r);
+		return false;
+	}
+	rmap_link(frame, r, dst, curr);
+	lock_release(&frame_lock);
+	cow_share_cnt++;
+	return true;
+}
+
+/* Take a reference to the LAZY_AUX AUX, which may be NULL, for a new page. */
+struct lazy_aux *
+lazy_aux_get (struct lazy_aux *aux) {
+	if(aux != NULL){
+		enum intr_level old_level = intr_disable();
+		aux->ref_cnt++;
+		intr_set_level(old_level);
+	}
+	return aux;
+}
+
+/* Drop a page's reference to the LAZY_AUX AUX, which may be NULL. The last one
+ * frees it, and closes its file if it has its own. */
+void
+lazy_aux_put (struct lazy_aux *aux) {
+	bool last;
+	if(aux == NULL){
+		return;
+	}
+	enum intr_level old_level = intr_disable();
+	last = --aux->ref_cnt == 0;
+	intr_set_level(old_level);
+	if(last){
+		if(aux->own_file){
+			file_close(aux->executable);
+		}
+		free(aux);
+	}
+}
+
 /* Claim the page that allocate on VA. */
 bool
 vm_claim_page (void *va UNUSED) {
@@ -277,23 +1419,222 @@ vm_claim_page (void *va UNUSED) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
-	/* Set links */
+	//A page that was read ahead takes its swap cache page as its frame.
+	void *cached = VM_TYPE(page->operations->type) == VM_ANON ? anon_swap_cache_take(page) : NULL;
+	struct frame *frame = cached != NULL ? vm_new_frame(cached) : vm_get_frame ();
+	ASSERT (frame != NULL);
+	bool success;
+	rmap_add(frame, page, thread_current());	//The frame's first entry : cannot fail.
+	/* Set links. Pinned : not a victim while swap_in() sleeps on the disk. */
+	lock_acquire(&frame_lock);
+	frame->pinned = true;
 	frame->page = page;
+	lock_release(&frame_lock);
 	page->frame = frame;
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable);
+	pml4_set_accessed(thread_current()->pml4, page->va, true);	//Not a victim before it is even used.
 	//printf("thread %d claimed page 0x%X\n",thread_current()->tid, page->va);
 
-	return swap_in (page, frame->kva);
+	success = swap_in (page, frame->kva);
+	lock_acquire(&frame_lock);
+	frame->pinned = false;
+	lock_release(&frame_lock);
+	return success;
+}
+
+/* Huge pages.
+ * A 2 MiB-aligned stretch of user memory made up entirely of
+ * writable anonymous pages that have never been loaded (typically
+ * a large array in .bss) is claimed in one go on its first fault:
+ * all 512 pages are loaded into a 2 MiB frame that is mapped by a
+ * single page directory entry.  Each 4 kB piece keeps its own
+ * struct frame, so eviction, copy-on-write and exit treat them as
+ * ordinary frames; the mmu splits the huge mapping back into 4 kB
+ * pages as soon as any one of them is unmapped or remapped. */
+
+/* Can PAGE be claimed as part of a huge page? */
+static bool
+huge_candidate (struct page *page) {
+	return page != NULL
+		&& VM_TYPE(page->operations->type) == VM_UNINIT
+		&& VM_TYPE(page->uninit.type) == VM_ANON
+		&& page->writable
+		&& page->frame == NULL
+		&& pml4_get_page(thread_current()->pml4, page->va) == NULL;
+}
+
+/* Returns true if every page of the 2 MiB region around PAGE is a
+ * huge page candidate. */
+static bool
+huge_region_claimable (struct page *page) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *base = hpg_round_down(page->va);
+	size_t i;
+
+	if(!is_user_vaddr(base + HPGSIZE - 1)){
+		return false;
+	}
+	//Check both ends first : most regions fail there.
+	if(!huge_candidate(spt_find_page(spt, base))
+			|| !huge_candidate(spt_find_page(spt, base + HPGSIZE - PGSIZE))){
+		return false;
+	}
+	for(i = 1; i < HPG_PAGES - 1; i++){
+		if(!huge_candidate(spt_find_page(spt, base + i * PGSIZE))){
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Claims the whole 2 MiB region around PAGE, which must have passed
+ * huge_region_claimable().  Falls back to claiming PAGE alone if no
+ * 2 MiB frame or bookkeeping memory is available. */
+static bool
+vm_do_claim_huge (struct page *page) {
+	struct thread *curr = thread_current();
+	struct supplemental_page_table *spt = &curr->spt;
+	uint8_t *base = hpg_round_down(page->va);
+	uint8_t *kva;
+	size_t i, linked = 0, loaded;
+
+	kva = palloc_get_huge_page(PAL_USER);
+	if(kva == NULL || pml4e_walk_pde(curr->pml4, (uint64_t) base, 1) == NULL){
+		goto fallback;
+	}
+	//1. Link every page to its 4 kB piece of the 2 MiB frame.
+	for(linked = 0; linked < HPG_PAGES; linked++){
+		struct page *p = spt_find_page(spt, base + linked * PGSIZE);
+		struct frame *frame = malloc(sizeof(struct frame));
+		if(frame == NULL){
+			goto fallback;
+		}
+		frame->kva = kva + linked * PGSIZE;
+		frame->page = p;
+		frame->owner = curr;
+		frame->ksm_sum = 0;
+		frame->ksm_candidate = false;
+		rmap_init(frame);
+		p->frame = frame;
+	}
+	//2. Load contents. Frames are not in the frame table yet, so none can be evicted under us.
+	for(loaded = 0; loaded < HPG_PAGES; loaded++){
+		struct page *p = spt_find_page(spt, base + loaded * PGSIZE);
+		if(!swap_in(p, p->frame->kva)){
+			goto fail;
+		}
+	}
+	//3. Map them, then publish the frames.
+	if(!pml4_set_huge_page(curr->pml4, base, kva, true)){
+		goto fail;
+	}
+	for(i = 0; i < HPG_PAGES; i++){
+		struct page *p = spt_find_page(spt, base + i * PGSIZE);
+		rmap_add(p->frame, p, curr);
+	}
+	lock_acquire(&frame_lock);
+	for(i = 0; i < HPG_PAGES; i++){
+		struct page *p = spt_find_page(spt, base + i * PGSIZE);
+		list_push_back(&frame_list, &p->frame->elem);
+	}
+	huge_map_cnt++;
+	lock_release(&frame_lock);
+	return true;
+
+fallback:
+	for(i = 0; i < linked; i++){
+		struct page *p = spt_find_page(spt, base + i * PGSIZE);
+		free(p->frame);
+		p->frame = NULL;
+	}
+	palloc_free_multiple(kva, kva != NULL ? HPG_PAGES : 0);
+	huge_fallback_cnt++;
+	return vm_do_claim_page(page);
+
+fail:	//Pages that loaded keep their pieces, mapped as 4 kB pages. The others go back to being lazy.
+	for(i = 0; i < HPG_PAGES; i++){
+		struct page *p = spt_find_page(spt, base + i * PGSIZE);
+		struct frame *frame = p->frame;
+		if(i < loaded && pml4_set_page(curr->pml4, p->va, frame->kva, p->writable)){
+			rmap_add(frame, p, curr);
+			lock_acquire(&frame_lock);
+			list_push_back(&frame_list, &frame->elem);
+			lock_release(&frame_lock);
+			continue;
+		}
+		if(VM_TYPE(p->operations->type) != VM_UNINIT){	//Initialized, but its contents are lost.
+			page_reset_uninit(p);
+		}
+		p->frame = NULL;
+		palloc_free_page(frame->kva);
+		free(frame);
+	}
+	return pml4_get_page(curr->pml4, page->va) != NULL;
+}
+
+/* Turn P, an anonymous page that swap_in() initialized, back into the
+ * uninitialized page it was, to be loaded again on its next fault. uninit_new()
+ * rebuilds the whole page, so the fields outside the union are saved around
+ * it. */
+static void
+page_reset_uninit (struct page *p) {
+	struct hash_elem hash_elem = p->hash_elem;
+	bool writable = p->writable;
+	uint8_t advice = p->advice;
+	bool mlocked = p->mlocked;
+	uninit_new(p, p->va, p->anon.init, p->anon.type, p->anon.aux, anon_initializer);
+	p->hash_elem = hash_elem;
+	p->writable = writable;
+	p->advice = advice;
+	p->mlocked = mlocked;
+}
+
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+	printf("Huge pages: %lld mapped, %lld split, %lld fallbacks\n",
+			huge_map_cnt, huge_page_splits, huge_fallback_cnt);
+	printf("Zero page: %lld read faults, %lld written\n", zero_map_cnt, zero_cow_cnt);
+	printf("File faults: %lld, %lld more pages loaded around them\n", file_fault_cnt, fault_around_cnt);
+	if(exec_cnt > 0){
+		printf("Exec: %lld programs, %llu cycles and %lld faults to the first system call on average\n",
+				exec_cnt, exec_cycles / exec_cnt, exec_fault_cnt / exec_cnt);
+	}
+	if(fork_cnt > 0){
+		printf("Fork: %lld address spaces copied, %llu cycles and %lld pages on average\n",
+				fork_cnt, fork_cycles / fork_cnt, fork_page_cnt / fork_cnt);
+	}
+	printf("madvise: %lld calls, %lld pages read ahead of use, %lld dropped, %lld evicted behind\n",
+			madvise_cnt, prefetch_cnt, drop_cnt, drop_behind_cnt);
+	printf("Populate: %lld pages, %lld batched file reads\n", populate_cnt, populate_read_cnt);
+	printf("mlock: %zu pages locked, up to %zu per process and %zu in all; "
+			"%lld calls refused, %lld locked frames passed over by eviction\n",
+			mlocked_cnt, vm_mlock_limit, vm_mlock_max, mlock_refuse_cnt, mlock_skip_cnt);
+	printf("Copy-on-write: %lld pages shared at fork, %lld copied, %lld taken back; "
+			"%lld frames handed over, %lld shared frames evicted\n",
+			cow_share_cnt, cow_copy_cnt, cow_reuse_cnt, rmap_promote_cnt, shared_evict_cnt);
+	printf("Eviction: %lld frames (%lld dirty), %lld scanned, %lld second chances\n",
+			evict_cnt, evict_dirty_cnt, clock_scan_cnt, second_chance_cnt);
+	printf("Reclaim: kswapd woke %lld times, %lld frames in %llu cycles; "
+			"%lld frames free on fault, %lld direct in %llu cycles (max %llu)\n",
+			kswapd_wake_cnt, kswapd_reclaim_cnt, kswapd_cycles,
+			frame_fast_cnt, frame_direct_cnt, frame_direct_cycles, frame_direct_max);
+	vm_anon_print_stats();
+	ksm_print_stats();
+	text_print_stats();
 }
 
 /* NEWCODE : Functions for supplemental page table's hash table. */
 /* Returns a hash value for page p. */
-static unsigned page_hash (const struct hash_elem *p_, void *aux UNUSED) {
+static uint64_t page_hash (const struct hash_elem *p_, void *aux UNUSED) {
 	const struct page *p = hash_entry (p_, struct page, hash_elem);
-	return hash_bytes (&p->va, sizeof p->va);
+	return hash_u64 ((uint64_t) p->va);
+}
+/* Returns true if page e is mapped at va (for hash_lookup). */
+static bool page_equal (const struct hash_elem *e, const void *va, void *aux UNUSED) {
+	return hash_entry (e, struct page, hash_elem)->va == va;
 }
 /* Returns true if page a precedes page b. */
 static bool page_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
@@ -307,65 +1648,96 @@ static bool page_less (const struct hash_elem *a_, const struct hash_elem *b_, v
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	spt->owner = thread_current();
-	hash_init(&spt->hash, page_hash, page_less, NULL);
+	if(vm_spt_hash){
+		hash_init(&spt->hash, page_hash, page_less, NULL);
+	}
+	else{
+		radix_init(&spt->radix);
+	}
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy page P of SRC into DST, the current thread's spt. */
+static bool
+spt_copy_page (struct supplemental_page_table *dst, struct supplemental_page_table *src, struct page *p) {
+	//printf("Going to copy page : 0x%X..\n", p->va);
+	//The LAZY_AUX, and the file in it, are shared with the child, whatever marker bits the type has.
+	void* aux = lazy_aux_get(p->uninit.aux);
+	fork_page_cnt++;
+	if(!vm_alloc_page_with_initializer(p->uninit.type, p->va, p->writable, p->uninit.init, aux)){	//page_get_type(p)
+		printf("SPT_COPY : failed to allocate page.\n");
+		lazy_aux_put(aux);
+		return false;
+	}
+	struct page* newp = spt_find_page(dst, p->va);
+	newp->advice = p->advice;
+	if(p->rmap != NULL){
+		/* COPY-ON-WRITE : Instead of claiming page here, just add the pml4 mapping & set write-protected!! */
+		return rmap_share(newp, p);
+	}
+	else if(VM_TYPE(p->operations->type) == VM_ANON && p->anon.ksm != NULL){	//Merged : the child gets a copy.
+		return ksm_copy(newp, p);
+	}
+	else if(VM_TYPE(p->operations->type) == VM_ANON && p->anon.text != NULL){	//Shared text : so is the child's.
+		return text_copy(newp, p);
+	}
+	else if(pml4_get_page(src->owner->pml4, p->va) != NULL){	//The zero page.
+		pml4_set_page(thread_current()->pml4, newp->va, pml4_get_page(src->owner->pml4, p->va), false);
+	}
+	else if(VM_TYPE(p->operations->type) == VM_ANON){	//Swapped out.
+		return anon_fork_swapped(newp, p);
+	}
+	return true;
+}
+
+/* Copy supplemental page table from src to dst.
+ * The frames SRC maps are shared copy-on-write : once DST maps them, all of
+ * SRC's page table is write protected in one pass, with one TLB flush. */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 		struct supplemental_page_table *src UNUSED) {
-	struct hash_iterator i;
-	hash_first (&i, &src->hash);
-	while(hash_next(&i)){
-		struct page *p = hash_entry(hash_cur (&i), struct page, hash_elem);	//get the SRC's page.
-		//printf("Going to copy page : 0x%X..\n", p->va);
-		void* aux = NULL;
-		switch(p->uninit.type){
-			case VM_ANON :
-				if(p->uninit.aux != NULL){
-					aux = malloc(sizeof(struct lazy_aux));
-					memcpy(aux, p->uninit.aux, sizeof(struct lazy_aux));
-				}
-				break;
-			case VM_FILE :
-				if(p->uninit.aux != NULL){
-					aux = malloc(sizeof(struct lazy_aux));
-					memcpy(aux, p->uninit.aux, sizeof(struct lazy_aux));
-				}
-				struct file* newfile = file_reopen(((struct lazy_aux*) aux)->executable);
-				((struct lazy_aux*) aux)->executable = newfile;
-				break;
-			default :
-				break;
+	uint64_t start = rdtsc();
+	bool success = true;
+	if(vm_spt_hash){
+		struct hash_iterator i;
+		hash_first (&i, &src->hash);
+		while(success && hash_next(&i)){
+			struct page *p = hash_entry(hash_cur (&i), struct page, hash_elem);	//get the SRC's page.
+			success = spt_copy_page(dst, src, p);
 		}
-		if(!vm_alloc_page_with_initializer(p->uninit.type, p->va, p->writable, p->uninit.init, aux)){	//page_get_type(p)
-			printf("SPT_COPY : failed to allocate page.\n");
-			return false;
-		}
-		struct page* newp = spt_find_page(dst, p->va);
-		if(p->frame != NULL){
-			/* COPY-ON-WRITE : Instead of claiming page here, just add the pml4 mapping & set write-protected!! */
-			pml4_set_page(thread_current()->pml4, newp->va, p->frame->kva, false);
-			pml4_clear_page(p->frame->owner->pml4, p->va);
-			pml4_set_page(p->frame->owner->pml4, p->va,p->frame->kva,false);
-		}
-		else if(pml4_get_page(src->owner->pml4, p->va) != NULL){
-			pml4_set_page(thread_current()->pml4, newp->va, pml4_get_page(src->owner->pml4, p->va), false);
+	}
+	else{	//Walk SRC in address order, a leaf at a time.
+		struct page *p;
+		void *va = NULL;
+		for(; success && (p = radix_next(&src->radix, &va)) != NULL; va += PGSIZE){
+			success = spt_copy_page(dst, src, p);
 		}
 	}
-	return true;
+	pml4_write_protect(src->owner->pml4);	//Even on failure : some frames may be shared already.
+	fork_cnt++;
+	fork_cycles += rdtsc() - start;
+	return success;
 }
 
-static void spt_free_page(struct hash_elem* e, void* aux UNUSED){
-	struct page* page = hash_entry(e, struct page, hash_elem);
+static void spt_free_page(void* page_){
+	struct page* page = page_;
+	vm_munlock_page(page);
 	destroy(page);
 	free(page);
 }
 
+static void spt_free_hash_elem(struct hash_elem* e, void* aux UNUSED){
+	spt_free_page(hash_entry(e, struct page, hash_elem));
+}
+
 /* Free the resource hold by the supplemental page table */
 void
 supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	hash_destroy(&spt->hash, spt_free_page);
+	if(vm_spt_hash){
+		hash_destroy(&spt->hash, spt_free_hash_elem);
+	}
+	else{
+		radix_destroy(&spt->radix, spt_free_page);
+	}
 }